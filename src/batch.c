@@ -0,0 +1,587 @@
+//========================================================//
+//  batch.c                                               //
+//  Source file for the batch job runner                  //
+//                                                        //
+//  Jobs are grouped into tasks that share the decoding   //
+//  of their trace and scheduled with work stealing       //
+//========================================================//
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "batch.h"
+#include "cache.h"
+#include "store.h"
+#include "trace.h"
+
+//------------------------------------//
+//        Batch Data Structures       //
+//------------------------------------//
+
+#define BATCH_MAX_THREADS 256
+
+// Tasks dealt to every worker, the more the finer the final balancing
+//
+#define BATCH_TASKS_PER_WORKER 4
+
+typedef struct batch_trace
+{
+  char *path;
+  trace_store *ts;          // Decoded once, read by every job of the trace
+} batch_trace;
+
+typedef struct batch_config
+{
+  char *name;
+  char *options;            // As written in the manifest
+  cache_context *ctx;       // Configured hierarchy, never simulated
+} batch_config;
+
+typedef struct batch_stats
+{
+  uint64_t refs, penalties;
+  cache_stats cache;
+} batch_stats;
+
+// The configurations 'first' to 'first + count - 1' of one trace.
+// Simulated together, so each chunk of the trace is decoded only once
+//
+typedef struct batch_task
+{
+  uint32_t trace;
+  uint32_t first, count;
+  uint64_t work;            // References to simulate
+} batch_task;
+
+// Tasks of one worker. The owner takes from the head, thieves from the tail
+//
+typedef struct batch_deque
+{
+  pthread_mutex_t lock;
+  uint32_t *task;
+  uint32_t head, tail;
+} batch_deque;
+
+typedef struct batch_worker
+{
+  pthread_t thread;
+  uint32_t id;
+} batch_worker;
+
+static batch_trace *traces;
+static uint32_t ntraces;
+static batch_config *configs;
+static uint32_t nconfigs;
+static batch_stats *results;   // One per job, trace-major
+static batch_task *tasks;
+static uint32_t ntasks;
+static batch_deque *deques;
+static uint32_t nworkers;
+
+//------------------------------------//
+//             Manifest               //
+//------------------------------------//
+
+// Parse the manifest, configuring every hierarchy from 'defaults'
+//
+static int
+read_manifest(const char *path, const cache_context *defaults,
+              int (*option)(char *arg))
+{
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    fprintf(stderr,"Unable to open manifest %s\n", path);
+    return 0;
+  }
+  const char *slash = strrchr(path, '/');
+  int dirLen = slash ? (int)(slash - path) + 1 : 0;
+
+  char *line = NULL;
+  size_t cap = 0;
+  uint64_t lineNo = 0;
+  int ok = 1;
+
+  while (ok && getline(&line, &cap, f) != -1) {
+    lineNo++;
+    char *save = NULL;
+    char *word = strtok_r(line, " \t\r\n", &save);
+    if (!word || word[0] == '#') {
+      continue;
+    }
+    char *rest = strtok_r(NULL, "\r\n", &save);
+    rest = rest ? rest + strspn(rest, " \t") : NULL;
+
+    if (!strcmp(word, "trace") && rest && rest[0]) {
+      char *p;
+      if (rest[0] == '/') {
+        p = strdup(rest);
+      } else if (asprintf(&p, "%.*s%s", dirLen, path, rest) < 0) {
+        p = NULL;
+      }
+      // A trace listed twice is simulated once
+      for (uint32_t t = 0; p && t < ntraces; t++) {
+        if (!strcmp(traces[t].path, p)) {
+          free(p);
+          p = NULL;
+        }
+      }
+      if (p) {
+        traces = (batch_trace *)realloc(traces,
+                                        (ntraces + 1) * sizeof(batch_trace));
+        traces[ntraces].path = p;
+        traces[ntraces++].ts = NULL;
+      }
+    } else if (!strcmp(word, "config") && rest && rest[0]) {
+      char *name = strtok_r(rest, " \t", &save);
+      char *options = strtok_r(NULL, "", &save);
+      options = strdup(options ? options + strspn(options, " \t") : "");
+
+      cache_restore(defaults);
+      char *args = strdup(options);
+      char *s2 = NULL;
+      for (char *arg = strtok_r(args, " \t", &s2); arg;
+           arg = strtok_r(NULL, " \t", &s2)) {
+        if (!option(arg)) {
+          fprintf(stderr,"Manifest error: unrecognized option %s (line %lu)\n",
+              arg, lineNo);
+          ok = 0;
+          break;
+        }
+      }
+      free(args);
+      if (!ok) {
+        free(options);
+        break;
+      }
+
+      configs = (batch_config *)realloc(configs,
+                                        (nconfigs + 1) * sizeof(batch_config));
+      configs[nconfigs].name = strdup(name);
+      configs[nconfigs].options = options;
+      configs[nconfigs++].ctx = cache_save(NULL);
+    } else {
+      fprintf(stderr,"Manifest error: expected 'trace <path>' or "
+          "'config <name> <options>' (line %lu)\n", lineNo);
+      ok = 0;
+    }
+  }
+  free(line);
+  fclose(f);
+  cache_restore(defaults);
+
+  if (ok && (!ntraces || !nconfigs)) {
+    fprintf(stderr,"Manifest error: %s lists no %s\n", path,
+        ntraces ? "config" : "trace");
+    ok = 0;
+  }
+  return ok;
+}
+
+//------------------------------------//
+//            Scheduling              //
+//------------------------------------//
+
+static int
+by_work(const void *a, const void *b)
+{
+  const batch_task *x = (const batch_task *)a;
+  const batch_task *y = (const batch_task *)b;
+  if (x->work != y->work) {
+    return (x->work < y->work) ? 1 : -1;
+  }
+  return (x->trace != y->trace) ? (int)x->trace - (int)y->trace
+                                : (int)x->first - (int)y->first;
+}
+
+// Split the jobs into tasks of about the same amount of work. The configs
+// of a small trace are packed into one task, those of a large trace are
+// simulated in tasks of their own
+//
+static void
+make_tasks()
+{
+  uint64_t total = 0;
+  for (uint32_t t = 0; t < ntraces; t++) {
+    total += traces[t].ts->refs * nconfigs;
+  }
+  uint64_t target = total / ((uint64_t)nworkers * BATCH_TASKS_PER_WORKER);
+
+  tasks = (batch_task *)malloc((size_t)ntraces * nconfigs * sizeof(batch_task));
+  ntasks = 0;
+  for (uint32_t t = 0; t < ntraces; t++) {
+    uint64_t refs = traces[t].ts->refs;
+    uint64_t per = (refs && target > refs) ? target / refs : 1;
+    if (per > nconfigs) {
+      per = nconfigs;
+    }
+    for (uint32_t c = 0; c < nconfigs; c += per) {
+      batch_task *k = &tasks[ntasks++];
+      k->trace = t;
+      k->first = c;
+      k->count = (nconfigs - c < per) ? nconfigs - c : (uint32_t)per;
+      k->work = refs * k->count;
+    }
+  }
+
+  // Deal the largest tasks first, round robin
+  qsort(tasks, ntasks, sizeof(batch_task), by_work);
+  deques = (batch_deque *)calloc(nworkers, sizeof(batch_deque));
+  for (uint32_t w = 0; w < nworkers; w++) {
+    pthread_mutex_init(&deques[w].lock, NULL);
+    deques[w].task = (uint32_t *)malloc((ntasks / nworkers + 1)
+                                        * sizeof(uint32_t));
+  }
+  for (uint32_t k = 0; k < ntasks; k++) {
+    batch_deque *d = &deques[k % nworkers];
+    d->task[d->tail++] = k;
+  }
+}
+
+// Next task of worker 'w': its own largest, else the smallest of another
+// worker. Returns False once every deque is empty
+//
+static int
+next_task(uint32_t w, uint32_t *task)
+{
+  batch_deque *d = &deques[w];
+  pthread_mutex_lock(&d->lock);
+  int found = d->head < d->tail;
+  if (found) {
+    *task = d->task[d->head++];
+  }
+  pthread_mutex_unlock(&d->lock);
+
+  for (uint32_t i = 1; !found && i < nworkers; i++) {
+    d = &deques[(w + i) % nworkers];
+    pthread_mutex_lock(&d->lock);
+    found = d->head < d->tail;
+    if (found) {
+      *task = d->task[--d->tail];
+    }
+    pthread_mutex_unlock(&d->lock);
+  }
+  return found;
+}
+
+// Empty every deque so the running workers stop after their current task
+//
+static void
+drop_tasks()
+{
+  for (uint32_t w = 0; w < nworkers; w++) {
+    pthread_mutex_lock(&deques[w].lock);
+    deques[w].head = deques[w].tail;
+    pthread_mutex_unlock(&deques[w].lock);
+  }
+}
+
+//------------------------------------//
+//            Simulation              //
+//------------------------------------//
+
+// Simulate every job of the task, one decoded chunk at a time
+//
+static void
+run_task(const batch_task *k, uint32_t *addr, char *i_or_d)
+{
+  const trace_store *ts = traces[k->trace].ts;
+  batch_stats *res = &results[(size_t)k->trace * nconfigs + k->first];
+  cache_context **ctx = (cache_context **)malloc(k->count
+                                                 * sizeof(cache_context *));
+
+  for (uint32_t j = 0; j < k->count; j++) {
+    cache_restore(configs[k->first + j].ctx);
+    init_cache();
+    ctx[j] = cache_save(NULL);
+  }
+  for (uint64_t c = 0; c < store_chunks(ts); c++) {
+    uint32_t n = store_decode(ts, c, addr, i_or_d);
+    for (uint32_t j = 0; j < k->count; j++) {
+      cache_restore(ctx[j]);
+      res[j].refs += n;
+      res[j].penalties += cache_access_batch(addr, i_or_d, n);
+      cache_save(ctx[j]);
+    }
+  }
+  for (uint32_t j = 0; j < k->count; j++) {
+    cache_restore(ctx[j]);
+    cache_stats_read(&res[j].cache);
+    free_cache();
+    free(ctx[j]);
+  }
+  free(ctx);
+}
+
+static void *
+worker_main(void *arg)
+{
+  batch_worker *me = (batch_worker *)arg;
+  uint32_t *addr = (uint32_t *)malloc(STORE_CHUNK * sizeof(uint32_t));
+  char *i_or_d = (char *)malloc(STORE_CHUNK);
+  uint32_t k;
+
+  while (next_task(me->id, &k)) {
+    run_task(&tasks[k], addr, i_or_d);
+  }
+  free(addr);
+  free(i_or_d);
+  return NULL;
+}
+
+//------------------------------------//
+//              Output                //
+//------------------------------------//
+
+static const char *statNames[] = {
+  "refs", "penalties",
+  "icache_refs", "icache_misses", "icache_penalties",
+  "dcache_refs", "dcache_misses", "dcache_penalties",
+  "l2cache_refs", "l2cache_misses", "l2cache_penalties",
+  "data_writes", "dcache_writebacks", "l2cache_writebacks",
+  "l2cache_bytes", "mem_bytes"
+};
+
+#define NSTATS (sizeof(statNames) / sizeof(statNames[0]))
+
+// The statistics of a job in the order of statNames
+//
+static void
+stat_values(const batch_stats *st, uint64_t v[NSTATS])
+{
+  v[0]  = st->refs;
+  v[1]  = st->penalties;
+  v[2]  = st->cache.icacheRefs;
+  v[3]  = st->cache.icacheMisses;
+  v[4]  = st->cache.icachePenalties;
+  v[5]  = st->cache.dcacheRefs;
+  v[6]  = st->cache.dcacheMisses;
+  v[7]  = st->cache.dcachePenalties;
+  v[8]  = st->cache.l2cacheRefs;
+  v[9]  = st->cache.l2cacheMisses;
+  v[10] = st->cache.l2cachePenalties;
+  v[11] = st->cache.dcacheWrites;
+  v[12] = st->cache.dcacheWritebacks;
+  v[13] = st->cache.l2cacheWritebacks;
+  v[14] = st->cache.l2cacheBytes;
+  v[15] = st->cache.memBytes;
+}
+
+static void
+csv_field(FILE *out, const char *s)
+{
+  if (!strpbrk(s, ",\"\n")) {
+    fputs(s, out);
+    return;
+  }
+  fputc('"', out);
+  for (; *s; s++) {
+    if (*s == '"') {
+      fputc('"', out);
+    }
+    fputc(*s, out);
+  }
+  fputc('"', out);
+}
+
+static void
+json_string(FILE *out, const char *s)
+{
+  fputc('"', out);
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\') {
+      fprintf(out, "\\%c", *s);
+    } else if ((unsigned char)*s < 0x20) {
+      fprintf(out, "\\u%04x", *s);
+    } else {
+      fputc(*s, out);
+    }
+  }
+  fputc('"', out);
+}
+
+static double
+avg_access_time(const batch_stats *st)
+{
+  return st->refs ? (double)st->penalties / st->refs : 0.0;
+}
+
+static void
+write_csv(FILE *out)
+{
+  fprintf(out, "trace,config,options,avg_access_time");
+  for (size_t s = 0; s < NSTATS; s++) {
+    fprintf(out, ",%s", statNames[s]);
+  }
+  fputc('\n', out);
+
+  for (uint32_t t = 0; t < ntraces; t++) {
+    for (uint32_t c = 0; c < nconfigs; c++) {
+      const batch_stats *st = &results[(size_t)t * nconfigs + c];
+      uint64_t v[NSTATS];
+      stat_values(st, v);
+      csv_field(out, traces[t].path);
+      fputc(',', out);
+      csv_field(out, configs[c].name);
+      fputc(',', out);
+      csv_field(out, configs[c].options);
+      fprintf(out, ",%.4f", avg_access_time(st));
+      for (size_t s = 0; s < NSTATS; s++) {
+        fprintf(out, ",%lu", v[s]);
+      }
+      fputc('\n', out);
+    }
+  }
+}
+
+static void
+write_json(FILE *out)
+{
+  fprintf(out, "[\n");
+  for (uint32_t t = 0; t < ntraces; t++) {
+    for (uint32_t c = 0; c < nconfigs; c++) {
+      const batch_stats *st = &results[(size_t)t * nconfigs + c];
+      uint64_t v[NSTATS];
+      stat_values(st, v);
+      fprintf(out, "  {\"trace\": ");
+      json_string(out, traces[t].path);
+      fprintf(out, ", \"config\": ");
+      json_string(out, configs[c].name);
+      fprintf(out, ", \"options\": ");
+      json_string(out, configs[c].options);
+      fprintf(out, ", \"avg_access_time\": %.4f", avg_access_time(st));
+      for (size_t s = 0; s < NSTATS; s++) {
+        fprintf(out, ", \"%s\": %lu", statNames[s], v[s]);
+      }
+      int last = (t == ntraces - 1 && c == nconfigs - 1);
+      fprintf(out, "}%s\n", last ? "" : ",");
+    }
+  }
+  fprintf(out, "]\n");
+}
+
+//------------------------------------//
+//             Batches                //
+//------------------------------------//
+
+static void
+free_batch()
+{
+  for (uint32_t t = 0; t < ntraces; t++) {
+    free(traces[t].path);
+    store_free(traces[t].ts);
+  }
+  for (uint32_t c = 0; c < nconfigs; c++) {
+    free(configs[c].name);
+    free(configs[c].options);
+    free(configs[c].ctx);
+  }
+  for (uint32_t w = 0; deques && w < nworkers; w++) {
+    pthread_mutex_destroy(&deques[w].lock);
+    free(deques[w].task);
+  }
+  free(traces);
+  free(configs);
+  free(results);
+  free(tasks);
+  free(deques);
+  traces = NULL;
+  configs = NULL;
+  results = NULL;
+  tasks = NULL;
+  deques = NULL;
+  ntraces = nconfigs = ntasks = 0;
+}
+
+int
+batch_run(const char *path, const char *output, int (*option)(char *arg))
+{
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+
+  // The hierarchy configured on the command line
+  cache_context *defaults = cache_save(NULL);
+  int ok = read_manifest(path, defaults, option);
+  free(defaults);
+
+  // Decode every trace once, each one split across the parser threads
+  for (uint32_t t = 0; ok && t < ntraces; t++) {
+    traces[t].ts = store_new();
+    if (!trace_parse_file(traces[t].path, store_append, traces[t].ts)) {
+      fprintf(stderr,"Unable to open trace file %s\n", traces[t].path);
+      ok = 0;
+    } else {
+      store_finish(traces[t].ts);
+    }
+  }
+  FILE *out = stdout;
+  if (ok && output && !(out = fopen(output, "w"))) {
+    fprintf(stderr,"Unable to open %s\n", output);
+    ok = 0;
+  }
+  if (!ok) {
+    free_batch();
+    return 0;
+  }
+
+  nworkers = traceThreads;
+  if (nworkers == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    nworkers = (cpus > 0) ? (uint32_t)cpus : 1;
+  }
+  if (nworkers > BATCH_MAX_THREADS) {
+    nworkers = BATCH_MAX_THREADS;
+  }
+  if (nworkers > ntraces * nconfigs) {
+    nworkers = ntraces * nconfigs;
+  }
+  results = (batch_stats *)calloc((size_t)ntraces * nconfigs,
+                                  sizeof(batch_stats));
+  make_tasks();
+
+  batch_worker worker[BATCH_MAX_THREADS];
+  uint32_t started = 0;
+  for (; started < nworkers; started++) {
+    worker[started].id = started;
+    int err = pthread_create(&worker[started].thread, NULL, worker_main,
+                             &worker[started]);
+    if (err) {
+      fprintf(stderr,"Unable to start batch worker: %s\n", strerror(err));
+      drop_tasks();
+      ok = 0;
+      break;
+    }
+  }
+  for (uint32_t w = 0; w < started; w++) {
+    pthread_join(worker[w].thread, NULL);
+  }
+  if (!ok) {
+    if (out != stdout) {
+      fclose(out);
+      unlink(output);
+    }
+    free_batch();
+    return 0;
+  }
+
+  size_t len = output ? strlen(output) : 0;
+  if (len >= 5 && !strcmp(output + len - 5, ".json")) {
+    write_json(out);
+  } else {
+    write_csv(out);
+  }
+  if (out != stdout && fclose(out)) {
+    fprintf(stderr,"Unable to write %s\n", output);
+    ok = 0;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  fprintf(stderr,"Batch: %u traces x %u configs in %u tasks on %u threads, "
+      "%.3f s\n", ntraces, nconfigs, ntasks, nworkers,
+      (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+
+  free_batch();
+  return ok;
+}
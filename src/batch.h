@@ -0,0 +1,46 @@
+//========================================================//
+//  batch.h                                               //
+//  Header file for the batch job runner                  //
+//                                                        //
+//  Simulates every trace of a manifest under every       //
+//  configuration on a pool of worker threads             //
+//========================================================//
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+//------------------------------------//
+//          Manifest Format           //
+//------------------------------------//
+
+// One directive per line, blank lines and lines starting with '#' are
+// ignored:
+//
+//   trace <path>                A text trace, relative paths start from
+//                               the directory of the manifest
+//   config <name> <options...>  A cache configuration, e.g.
+//                               "config arm --icache=128:2:2 --memspeed=100"
+//
+// Every trace is simulated under every configuration. Each trace is
+// decoded once and shared by all of its jobs
+//
+
+//------------------------------------//
+//      Batch Function Prototypes     //
+//------------------------------------//
+
+// Run the jobs of the manifest at 'path' on 'traceThreads' workers and
+// write one result per job to 'output', or to stdout if NULL. The output
+// is JSON if its name ends in ".json", CSV otherwise. The current cache
+// configuration is the default of every config, 'option' applies the
+// options of a config to it and must accept only options of the cache
+// hierarchy. If a worker can't be started the run fails.
+//
+// Returns True if Successful
+//
+int batch_run(const char *path, const char *output, int (*option)(char *arg));
+
+#endif
@@ -21,37 +21,48 @@ const char *email       = "shmodi@eng.ucsd.edu";
 //        Cache Configuration         //
 //------------------------------------//
 
-uint32_t icacheSets;     // Number of sets in the I$
-uint32_t icacheAssoc;    // Associativity of the I$
-uint32_t icacheHitTime;  // Hit Time of the I$
+__thread uint32_t icacheSets;     // Number of sets in the I$
+__thread uint32_t icacheAssoc;    // Associativity of the I$
+__thread uint32_t icacheHitTime;  // Hit Time of the I$
 
-uint32_t dcacheSets;     // Number of sets in the D$
-uint32_t dcacheAssoc;    // Associativity of the D$
-uint32_t dcacheHitTime;  // Hit Time of the D$
+__thread uint32_t dcacheSets;     // Number of sets in the D$
+__thread uint32_t dcacheAssoc;    // Associativity of the D$
+__thread uint32_t dcacheHitTime;  // Hit Time of the D$
 
-uint32_t l2cacheSets;    // Number of sets in the L2$
-uint32_t l2cacheAssoc;   // Associativity of the L2$
-uint32_t l2cacheHitTime; // Hit Time of the L2$
-uint32_t inclusive;      // Indicates if the L2 is inclusive
+__thread uint32_t l2cacheSets;    // Number of sets in the L2$
+__thread uint32_t l2cacheAssoc;   // Associativity of the L2$
+__thread uint32_t l2cacheHitTime; // Hit Time of the L2$
+__thread uint32_t inclusive;      // Indicates if the L2 is inclusive
 
-uint32_t blocksize;      // Block/Line size
-uint32_t memspeed;       // Latency of Main Memory
+__thread uint32_t dcacheWriteBack;   // D$ writes back dirty blocks (else writes through)
+__thread uint32_t dcacheWriteAlloc;  // D$ allocates blocks on write misses
+__thread uint32_t l2cacheWriteBack;  // L2$ writes back dirty blocks (else writes through)
+__thread uint32_t l2cacheWriteAlloc; // L2$ allocates blocks on write misses
+
+__thread uint32_t blocksize;      // Block/Line size
+__thread uint32_t memspeed;       // Latency of Main Memory
 
 //------------------------------------//
 //          Cache Statistics          //
 //------------------------------------//
 
-uint64_t icacheRefs;       // I$ references
-uint64_t icacheMisses;     // I$ misses
-uint64_t icachePenalties;  // I$ penalties
+__thread uint64_t icacheRefs;       // I$ references
+__thread uint64_t icacheMisses;     // I$ misses
+__thread uint64_t icachePenalties;  // I$ penalties
+
+__thread uint64_t dcacheRefs;       // D$ references
+__thread uint64_t dcacheMisses;     // D$ misses
+__thread uint64_t dcachePenalties;  // D$ penalties
 
-uint64_t dcacheRefs;       // D$ references
-uint64_t dcacheMisses;     // D$ misses
-uint64_t dcachePenalties;  // D$ penalties
+__thread uint64_t l2cacheRefs;      // L2$ references
+__thread uint64_t l2cacheMisses;    // L2$ misses
+__thread uint64_t l2cachePenalties; // L2$ penalties
 
-uint64_t l2cacheRefs;      // L2$ references
-uint64_t l2cacheMisses;    // L2$ misses
-uint64_t l2cachePenalties; // L2$ penalties
+__thread uint64_t dcacheWrites;      // Data write references
+__thread uint64_t dcacheWritebacks;  // Dirty D$ blocks written back
+__thread uint64_t l2cacheWritebacks; // Dirty L2$ blocks written back to memory
+__thread uint64_t l2cacheBytes;      // Bytes moved between the L1s and the L2$
+__thread uint64_t memBytes;          // Bytes moved between the caches and memory
 
 //------------------------------------//
 //        Cache Data Structures       //
@@ -62,6 +73,7 @@ typedef struct block
 {
 	struct block *prev_block, *next_block;
 	uint32_t tag;
+	uint8_t dirty;
 }block;
 
 typedef struct set_queue
@@ -131,23 +143,23 @@ void free_rear_block(set_queue* current_set)
 // Add your Cache data structures here
 //
 
-set_queue* icache;
-set_queue* dcache;
-set_queue* l2cache;
+__thread set_queue* icache;
+__thread set_queue* dcache;
+__thread set_queue* l2cache;
 
-uint32_t block_offset_bits; 
-uint32_t icache_index_bits ;
-uint32_t dcache_index_bits ;
-uint32_t l2cache_index_bits;
+__thread uint32_t block_offset_bits; 
+__thread uint32_t icache_index_bits ;
+__thread uint32_t dcache_index_bits ;
+__thread uint32_t l2cache_index_bits;
 
-uint32_t mask_block_offset;
-uint32_t mask_icache_set  ;
-uint32_t mask_dcache_set  ;
-uint32_t mask_l2cache_set ;
+__thread uint32_t mask_block_offset;
+__thread uint32_t mask_icache_set  ;
+__thread uint32_t mask_dcache_set  ;
+__thread uint32_t mask_l2cache_set ;
 
-uint32_t icache_current_index;
-uint32_t dcache_current_index;
-uint32_t l2cache_current_index;
+__thread uint32_t icache_current_index;
+__thread uint32_t dcache_current_index;
+__thread uint32_t l2cache_current_index;
 
 void invalidate(uint32_t addr)
 {
@@ -197,6 +209,12 @@ void invalidate(uint32_t addr)
 	{
 		if(temp->tag == tag)
 		{
+			// Dirty data goes straight to memory
+			if(temp->dirty)
+			{
+				dcacheWritebacks++;
+				memBytes += blocksize;
+			}
 			if(temp->prev_block == NULL)
 			{
 				free(temp);
@@ -222,6 +240,24 @@ void invalidate(uint32_t addr)
 	}
 }
 
+struct cache_context
+{
+  uint32_t icacheSets, icacheAssoc, icacheHitTime;
+  uint32_t dcacheSets, dcacheAssoc, dcacheHitTime;
+  uint32_t l2cacheSets, l2cacheAssoc, l2cacheHitTime;
+  uint32_t inclusive, blocksize, memspeed;
+  uint32_t dcacheWriteBack, dcacheWriteAlloc;
+  uint32_t l2cacheWriteBack, l2cacheWriteAlloc;
+
+  cache_stats stats;
+
+  set_queue *icache, *dcache, *l2cache;
+  uint32_t block_offset_bits;
+  uint32_t icache_index_bits, dcache_index_bits, l2cache_index_bits;
+  uint32_t mask_block_offset;
+  uint32_t mask_icache_set, mask_dcache_set, mask_l2cache_set;
+};
+
 //------------------------------------//
 //          Cache Functions           //
 //------------------------------------//
@@ -241,6 +277,11 @@ init_cache()
   l2cacheRefs       = 0;
   l2cacheMisses     = 0;
   l2cachePenalties  = 0;
+  dcacheWrites      = 0;
+  dcacheWritebacks  = 0;
+  l2cacheWritebacks = 0;
+  l2cacheBytes      = 0;
+  memBytes          = 0;
   
   //
   //Initialize Cache Simulator Data Structures
@@ -283,6 +324,186 @@ init_cache()
   
 }
 
+// Release the Cache Hierarchy
+//
+void
+free_cache()
+{
+  set_queue *caches[3] = {icache, dcache, l2cache};
+  uint32_t sets[3] = {icacheSets, dcacheSets, l2cacheSets};
+
+  for(int c=0; c<3; c++)
+  {
+	for(uint32_t i=0; i<sets[c]; i++)
+	{
+		while(caches[c][i].set_rear_block != NULL)
+			free_rear_block(&caches[c][i]);
+	}
+	free(caches[c]);
+  }
+  icache = NULL;
+  dcache = NULL;
+  l2cache = NULL;
+}
+
+// Save the current cache hierarchy into 'ctx', allocated if NULL
+//
+cache_context *
+cache_save(cache_context *ctx)
+{
+  if(ctx == NULL)
+	ctx = (cache_context*)malloc(sizeof(cache_context));
+
+  ctx->icacheSets = icacheSets;
+  ctx->icacheAssoc = icacheAssoc;
+  ctx->icacheHitTime = icacheHitTime;
+  ctx->dcacheSets = dcacheSets;
+  ctx->dcacheAssoc = dcacheAssoc;
+  ctx->dcacheHitTime = dcacheHitTime;
+  ctx->l2cacheSets = l2cacheSets;
+  ctx->l2cacheAssoc = l2cacheAssoc;
+  ctx->l2cacheHitTime = l2cacheHitTime;
+  ctx->inclusive = inclusive;
+  ctx->blocksize = blocksize;
+  ctx->memspeed = memspeed;
+  ctx->dcacheWriteBack = dcacheWriteBack;
+  ctx->dcacheWriteAlloc = dcacheWriteAlloc;
+  ctx->l2cacheWriteBack = l2cacheWriteBack;
+  ctx->l2cacheWriteAlloc = l2cacheWriteAlloc;
+
+  cache_stats_read(&ctx->stats);
+
+  ctx->icache = icache;
+  ctx->dcache = dcache;
+  ctx->l2cache = l2cache;
+  ctx->block_offset_bits = block_offset_bits;
+  ctx->icache_index_bits = icache_index_bits;
+  ctx->dcache_index_bits = dcache_index_bits;
+  ctx->l2cache_index_bits = l2cache_index_bits;
+  ctx->mask_block_offset = mask_block_offset;
+  ctx->mask_icache_set = mask_icache_set;
+  ctx->mask_dcache_set = mask_dcache_set;
+  ctx->mask_l2cache_set = mask_l2cache_set;
+  return ctx;
+}
+
+// Make the hierarchy saved in 'ctx' the current one
+//
+void
+cache_restore(const cache_context *ctx)
+{
+  icacheSets = ctx->icacheSets;
+  icacheAssoc = ctx->icacheAssoc;
+  icacheHitTime = ctx->icacheHitTime;
+  dcacheSets = ctx->dcacheSets;
+  dcacheAssoc = ctx->dcacheAssoc;
+  dcacheHitTime = ctx->dcacheHitTime;
+  l2cacheSets = ctx->l2cacheSets;
+  l2cacheAssoc = ctx->l2cacheAssoc;
+  l2cacheHitTime = ctx->l2cacheHitTime;
+  inclusive = ctx->inclusive;
+  blocksize = ctx->blocksize;
+  memspeed = ctx->memspeed;
+  dcacheWriteBack = ctx->dcacheWriteBack;
+  dcacheWriteAlloc = ctx->dcacheWriteAlloc;
+  l2cacheWriteBack = ctx->l2cacheWriteBack;
+  l2cacheWriteAlloc = ctx->l2cacheWriteAlloc;
+
+  cache_stats_write(&ctx->stats);
+
+  icache = ctx->icache;
+  dcache = ctx->dcache;
+  l2cache = ctx->l2cache;
+  block_offset_bits = ctx->block_offset_bits;
+  icache_index_bits = ctx->icache_index_bits;
+  dcache_index_bits = ctx->dcache_index_bits;
+  l2cache_index_bits = ctx->l2cache_index_bits;
+  mask_block_offset = ctx->mask_block_offset;
+  mask_icache_set = ctx->mask_icache_set;
+  mask_dcache_set = ctx->mask_dcache_set;
+  mask_l2cache_set = ctx->mask_l2cache_set;
+}
+
+//------------------------------------//
+//          Statistics Snapshots      //
+//------------------------------------//
+
+void
+cache_stats_read(cache_stats *st)
+{
+  st->icacheRefs        = icacheRefs;
+  st->icacheMisses      = icacheMisses;
+  st->icachePenalties   = icachePenalties;
+  st->dcacheRefs        = dcacheRefs;
+  st->dcacheMisses      = dcacheMisses;
+  st->dcachePenalties   = dcachePenalties;
+  st->l2cacheRefs       = l2cacheRefs;
+  st->l2cacheMisses     = l2cacheMisses;
+  st->l2cachePenalties  = l2cachePenalties;
+  st->dcacheWrites      = dcacheWrites;
+  st->dcacheWritebacks  = dcacheWritebacks;
+  st->l2cacheWritebacks = l2cacheWritebacks;
+  st->l2cacheBytes      = l2cacheBytes;
+  st->memBytes          = memBytes;
+}
+
+void
+cache_stats_write(const cache_stats *st)
+{
+  icacheRefs        = st->icacheRefs;
+  icacheMisses      = st->icacheMisses;
+  icachePenalties   = st->icachePenalties;
+  dcacheRefs        = st->dcacheRefs;
+  dcacheMisses      = st->dcacheMisses;
+  dcachePenalties   = st->dcachePenalties;
+  l2cacheRefs       = st->l2cacheRefs;
+  l2cacheMisses     = st->l2cacheMisses;
+  l2cachePenalties  = st->l2cachePenalties;
+  dcacheWrites      = st->dcacheWrites;
+  dcacheWritebacks  = st->dcacheWritebacks;
+  l2cacheWritebacks = st->l2cacheWritebacks;
+  l2cacheBytes      = st->l2cacheBytes;
+  memBytes          = st->memBytes;
+}
+
+void
+cache_stats_sub(cache_stats *st, const cache_stats *before)
+{
+  st->icacheRefs        -= before->icacheRefs;
+  st->icacheMisses      -= before->icacheMisses;
+  st->icachePenalties   -= before->icachePenalties;
+  st->dcacheRefs        -= before->dcacheRefs;
+  st->dcacheMisses      -= before->dcacheMisses;
+  st->dcachePenalties   -= before->dcachePenalties;
+  st->l2cacheRefs       -= before->l2cacheRefs;
+  st->l2cacheMisses     -= before->l2cacheMisses;
+  st->l2cachePenalties  -= before->l2cachePenalties;
+  st->dcacheWrites      -= before->dcacheWrites;
+  st->dcacheWritebacks  -= before->dcacheWritebacks;
+  st->l2cacheWritebacks -= before->l2cacheWritebacks;
+  st->l2cacheBytes      -= before->l2cacheBytes;
+  st->memBytes          -= before->memBytes;
+}
+
+void
+cache_stats_add_scaled(cache_stats *st, const cache_stats *part, double scale)
+{
+  st->icacheRefs        += llround(scale * part->icacheRefs);
+  st->icacheMisses      += llround(scale * part->icacheMisses);
+  st->icachePenalties   += llround(scale * part->icachePenalties);
+  st->dcacheRefs        += llround(scale * part->dcacheRefs);
+  st->dcacheMisses      += llround(scale * part->dcacheMisses);
+  st->dcachePenalties   += llround(scale * part->dcachePenalties);
+  st->l2cacheRefs       += llround(scale * part->l2cacheRefs);
+  st->l2cacheMisses     += llround(scale * part->l2cacheMisses);
+  st->l2cachePenalties  += llround(scale * part->l2cachePenalties);
+  st->dcacheWrites      += llround(scale * part->dcacheWrites);
+  st->dcacheWritebacks  += llround(scale * part->dcacheWritebacks);
+  st->l2cacheWritebacks += llround(scale * part->l2cacheWritebacks);
+  st->l2cacheBytes      += llround(scale * part->l2cacheBytes);
+  st->memBytes          += llround(scale * part->memBytes);
+}
+
 // Perform a memory access through the icache interface for the address 'addr'
 // Return the access time for the memory operation
 //
@@ -328,6 +549,7 @@ icache_access(uint32_t addr)
 		}
 		block *new_icache_block = malloc(sizeof(block));
 		new_icache_block->tag = tag;
+		new_icache_block->dirty = 0;
 		add_block_to_front(&icache[icache_current_index], new_icache_block);
 		icachePenalties+=l2_access_penalty;
 		icacheMisses++;       
@@ -342,30 +564,167 @@ icache_access(uint32_t addr)
   return memspeed;
 }
 
-// Perform a memory access through the dcache interface for the address 'addr'
+// Kinds of requests sent to the L2$
+//
+#define XFER_READ      0  // Fetch a block
+#define XFER_WRITE     1  // Store a word (write-through or no-write-allocate)
+#define XFER_WRITEBACK 2  // Write back a dirty block, not a reference
+
+#define WORD_SIZE 4       // Bytes stored by a write
+
+// Rebuild the address of a block from its tag and set
+//
+uint32_t block_addr(uint32_t tag, uint32_t index, uint32_t index_bits)
+{
+	uint32_t shift = index_bits + block_offset_bits;
+	return ((shift < 32) ? (tag << shift) : 0) | (index << block_offset_bits);
+}
+
+// Evict the LRU block of L2$ set 'index', writing it back if dirty
+//
+void l2cache_evict(uint32_t index)
+{
+	block *victim = l2cache[index].set_rear_block;
+	if(victim != NULL && victim->dirty)
+	{
+		l2cacheWritebacks++;
+		memBytes += blocksize;
+	}
+	free_rear_block(&l2cache[index]);
+}
+
+// Perform a request of the given kind to the l2cache for the address 'addr'
+// Return the access time for the memory operation, 0 for write-backs
+// which are absorbed by a write buffer
+//
+uint32_t
+l2cache_transfer(uint32_t addr, int kind)
+{
+  uint32_t tag;
+  uint32_t index;
+  uint8_t i =0;
+  uint8_t l2cachehit =0;
+  uint32_t bytes = (kind == XFER_WRITE) ? WORD_SIZE : blocksize;
+  
+  if(l2cacheSets==0)
+  {
+		memBytes += bytes;
+		return (kind == XFER_WRITEBACK) ? 0 : memspeed;
+  }
+  
+  l2cacheBytes += bytes;
+  if(kind != XFER_WRITEBACK)
+	l2cacheRefs++;
+  
+  tag = addr >> (block_offset_bits + l2cache_index_bits);
+  index = (addr & mask_l2cache_set) >> block_offset_bits;
+  l2cache_current_index = index;
+  block *temp = l2cache[index].set_front_block;
+  
+  for(i=0; (i<l2cacheAssoc) && (temp!= NULL); i++)
+  {
+	if(temp->tag == tag)
+	{
+		l2cachehit = 1;
+		break;
+	}
+	temp = temp->next_block;
+  }
+    
+  switch(l2cachehit)
+  {
+	  case 0://l2cache_miss
+		if(kind != XFER_READ && !l2cacheWriteAlloc)
+		{
+			memBytes += bytes;
+			if(kind == XFER_WRITEBACK)
+				return 0;
+			l2cacheMisses++;
+			l2cachePenalties+= memspeed;
+			return l2cacheHitTime + memspeed;
+		}
+        if(i == (l2cacheAssoc))
+		{
+			l2cache_evict(index);
+			if(inclusive == TRUE)
+			{
+				invalidate(addr);
+			}
+		}
+		block *new_l2cache_block = malloc(sizeof(block));
+		new_l2cache_block->tag = tag;
+		new_l2cache_block->dirty = (kind != XFER_READ && l2cacheWriteBack);
+		add_block_to_front(&l2cache[index], new_l2cache_block);
+		if(kind != XFER_READ && !l2cacheWriteBack)
+			memBytes += bytes;
+		// A written back block is whole, there is nothing to fetch
+		if(kind == XFER_WRITEBACK)
+			return 0;
+		memBytes += blocksize;
+		l2cacheMisses++;
+		l2cachePenalties+= memspeed;
+		return l2cacheHitTime + memspeed;
+		break;
+	  
+	  case 1://l2cache_hit       
+		bring_block_to_front(&l2cache[index], temp);
+		if(kind != XFER_READ)
+		{
+			if(l2cacheWriteBack)
+				temp->dirty = 1;
+			else
+				memBytes += bytes;
+		}
+		return (kind == XFER_WRITEBACK) ? 0 : l2cacheHitTime;
+		break;
+  }  
+  return memspeed;
+}
+
+// Evict the LRU block of D$ set 'index', writing it back if dirty
+//
+void dcache_evict(uint32_t index)
+{
+	block *victim = dcache[index].set_rear_block;
+	if(victim == NULL)
+		return;
+	uint32_t tag = victim->tag;
+	uint8_t dirty = victim->dirty;
+	free_rear_block(&dcache[index]);
+	if(dirty)
+	{
+		dcacheWritebacks++;
+		l2cache_transfer(block_addr(tag, index, dcache_index_bits), XFER_WRITEBACK);
+	}
+}
+
+// Perform a read or a write through the dcache interface for the address
+// 'addr'. Writes through to the L2$ are absorbed by a write buffer
 // Return the access time for the memory operation
 //
 uint32_t
-dcache_access(uint32_t addr)
+dcache_transfer(uint32_t addr, uint8_t write)
 {
-  //
-  //Implement D$
-  //
   uint32_t tag;
+  uint32_t index;
   uint8_t dcachehit = 0;
   uint8_t i = 0;
   uint32_t l2_access_penalty = 0;
   
+  if(write)
+	dcacheWrites++;
+  
   if(dcacheSets==0)
   {
-		return l2cache_access(addr);
+		return l2cache_transfer(addr, write ? XFER_WRITE : XFER_READ);
   }
   
   dcacheRefs++;
  
   tag = addr >> (block_offset_bits + dcache_index_bits);
-  dcache_current_index = (addr & mask_dcache_set) >> block_offset_bits;
-  block *temp = dcache[dcache_current_index].set_front_block;
+  index = (addr & mask_dcache_set) >> block_offset_bits;
+  dcache_current_index = index;
+  block *temp = dcache[index].set_front_block;
   
   for(i=0; (i<dcacheAssoc) && (temp!= NULL); i++)
   {
@@ -380,19 +739,36 @@ dcache_access(uint32_t addr)
   switch(dcachehit)
   {
 	  case 0://dcache_miss
-		l2_access_penalty = l2cache_access(addr);
+		dcacheMisses++;
+		if(write && !dcacheWriteAlloc)
+		{
+			l2_access_penalty = l2cache_transfer(addr, XFER_WRITE);
+			dcachePenalties+=l2_access_penalty;
+			return dcacheHitTime + l2_access_penalty;
+		}
+		// Write back the victim first so the fill can't be displaced by it
         if(i == (dcacheAssoc))
-			free_rear_block(&dcache[dcache_current_index]);
+			dcache_evict(index);
+		l2_access_penalty = l2cache_transfer(addr, XFER_READ);
 		block *new_dcache_block = malloc(sizeof(block));
 		new_dcache_block->tag = tag;
-		add_block_to_front(&dcache[dcache_current_index], new_dcache_block);
+		new_dcache_block->dirty = (write && dcacheWriteBack);
+		add_block_to_front(&dcache[index], new_dcache_block);
+		if(write && !dcacheWriteBack)
+			l2cache_transfer(addr, XFER_WRITE);
 		dcachePenalties+=l2_access_penalty;
-		dcacheMisses++;
 		return dcacheHitTime + l2_access_penalty;
 		break;
 	  
 	  case 1://dcache_hit
-		bring_block_to_front(&dcache[dcache_current_index], temp);
+		bring_block_to_front(&dcache[index], temp);
+		if(write)
+		{
+			if(dcacheWriteBack)
+				temp->dirty = 1;
+			else
+				l2cache_transfer(addr, XFER_WRITE);
+		}
 		return dcacheHitTime;
 		break;
 
@@ -400,65 +776,50 @@ dcache_access(uint32_t addr)
   return memspeed;
 }
 
+// Perform a memory access through the dcache interface for the address 'addr'
+// Return the access time for the memory operation
+//
+uint32_t
+dcache_access(uint32_t addr)
+{
+  return dcache_transfer(addr, FALSE);
+}
+
+// Perform a write through the dcache interface for the address 'addr'
+// Return the access time for the memory operation
+//
+uint32_t
+dcache_write(uint32_t addr)
+{
+  return dcache_transfer(addr, TRUE);
+}
+
 // Perform a memory access to the l2cache for the address 'addr'
 // Return the access time for the memory operation
 //
 uint32_t
 l2cache_access(uint32_t addr)
 {
-  //
-  //TODO: Implement L2$
-  //
-  
-  uint32_t tag;
-  uint8_t i =0;
-  uint8_t l2cachehit =0;
-  
-  if(l2cacheSets==0)
-  {
-		return memspeed;
-  }
-  
-  l2cacheRefs++;
-  
-  
-  tag = addr >> (block_offset_bits + l2cache_index_bits);
-  l2cache_current_index = (addr & mask_l2cache_set) >> block_offset_bits;
-  block *temp = l2cache[l2cache_current_index].set_front_block;
-  
-  for(i=0; (i<l2cacheAssoc) && (temp!= NULL); i++)
+  return l2cache_transfer(addr, XFER_READ);
+}
+
+// Perform 'n' memory accesses, directing 'addr[k]' to the icache or the
+// dcache according to 'i_or_d[k]' ('I', 'D' or 'R' for reads, 'W' for writes)
+// Return the total access time for the batch
+//
+uint64_t
+cache_access_batch(const uint32_t *addr, const char *i_or_d, size_t n)
+{
+  uint64_t penalties = 0;
+
+  for(size_t k=0; k<n; k++)
   {
-	if(temp->tag == tag)
-	{
-		l2cachehit = 1;
-		break;
-	}
-	temp = temp->next_block;
+	if(i_or_d[k] == 'I')
+		penalties += icache_access(addr[k]);
+	else if(i_or_d[k] == 'W')
+		penalties += dcache_write(addr[k]);
+	else
+		penalties += dcache_access(addr[k]);
   }
-    
-  switch(l2cachehit)
-  {
-	  case 0://l2cache_miss
-        if(i == (l2cacheAssoc))
-		{
-			free_rear_block(&l2cache[l2cache_current_index]);
-			if(inclusive == TRUE)
-			{
-				invalidate(addr);
-			}
-		}
-		block *new_l2cache_block = malloc(sizeof(block));
-		new_l2cache_block->tag = tag;
-		add_block_to_front(&l2cache[l2cache_current_index], new_l2cache_block);
-		l2cacheMisses++;
-		l2cachePenalties+= memspeed;
-		return l2cacheHitTime + memspeed;
-		break;
-	  
-	  case 1://l2cache_hit       
-		bring_block_to_front(&l2cache[l2cache_current_index], temp);
-		return l2cacheHitTime;
-		break;
-  }  
-  return memspeed;
+  return penalties;
 }
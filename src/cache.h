@@ -30,37 +30,71 @@ extern const char *email;
 //        Cache Configuration         //
 //------------------------------------//
 
-extern uint32_t icacheSets;     // Number of sets in the I$
-extern uint32_t icacheAssoc;    // Associativity of the I$
-extern uint32_t icacheHitTime;  // Hit Time of the I$
+// The configuration, statistics and contents of the hierarchy are per
+// thread, so several threads can each run a simulator of their own
+//
+extern __thread uint32_t icacheSets;     // Number of sets in the I$
+extern __thread uint32_t icacheAssoc;    // Associativity of the I$
+extern __thread uint32_t icacheHitTime;  // Hit Time of the I$
+
+extern __thread uint32_t dcacheSets;     // Number of sets in the D$
+extern __thread uint32_t dcacheAssoc;    // Associativity of the D$
+extern __thread uint32_t dcacheHitTime;  // Hit Time of the D$
 
-extern uint32_t dcacheSets;     // Number of sets in the D$
-extern uint32_t dcacheAssoc;    // Associativity of the D$
-extern uint32_t dcacheHitTime;  // Hit Time of the D$
+extern __thread uint32_t l2cacheSets;    // Number of sets in the L2$
+extern __thread uint32_t l2cacheAssoc;   // Associativity of the L2$
+extern __thread uint32_t l2cacheHitTime; // Hit Time of the L2$
+extern __thread uint32_t inclusive;      // Indicates if the L2 is inclusive
 
-extern uint32_t l2cacheSets;    // Number of sets in the L2$
-extern uint32_t l2cacheAssoc;   // Associativity of the L2$
-extern uint32_t l2cacheHitTime; // Hit Time of the L2$
-extern uint32_t inclusive;      // Indicates if the L2 is inclusive
+extern __thread uint32_t dcacheWriteBack;   // D$ writes back dirty blocks (else writes through)
+extern __thread uint32_t dcacheWriteAlloc;  // D$ allocates blocks on write misses
+extern __thread uint32_t l2cacheWriteBack;  // L2$ writes back dirty blocks (else writes through)
+extern __thread uint32_t l2cacheWriteAlloc; // L2$ allocates blocks on write misses
 
-extern uint32_t blocksize;      // Block/Line size
-extern uint32_t memspeed;       // Latency of Main Memory
+extern __thread uint32_t blocksize;      // Block/Line size
+extern __thread uint32_t memspeed;       // Latency of Main Memory
 
 //------------------------------------//
 //          Cache Statistics          //
 //------------------------------------//
 
-extern uint64_t icacheRefs;       // I$ references
-extern uint64_t icacheMisses;     // I$ misses
-extern uint64_t icachePenalties;  // I$ penalties
+extern __thread uint64_t icacheRefs;       // I$ references
+extern __thread uint64_t icacheMisses;     // I$ misses
+extern __thread uint64_t icachePenalties;  // I$ penalties
+
+extern __thread uint64_t dcacheRefs;       // D$ references
+extern __thread uint64_t dcacheMisses;     // D$ misses
+extern __thread uint64_t dcachePenalties;  // D$ penalties
+
+extern __thread uint64_t l2cacheRefs;      // L2$ references
+extern __thread uint64_t l2cacheMisses;    // L2$ misses
+extern __thread uint64_t l2cachePenalties; // L2$ penalties
 
-extern uint64_t dcacheRefs;       // D$ references
-extern uint64_t dcacheMisses;     // D$ misses
-extern uint64_t dcachePenalties;  // D$ penalties
+extern __thread uint64_t dcacheWrites;      // Data write references
+extern __thread uint64_t dcacheWritebacks;  // Dirty D$ blocks written back
+extern __thread uint64_t l2cacheWritebacks; // Dirty L2$ blocks written back to memory
+extern __thread uint64_t l2cacheBytes;      // Bytes moved between the L1s and the L2$
+extern __thread uint64_t memBytes;          // Bytes moved between the caches and memory
 
-extern uint64_t l2cacheRefs;      // L2$ references
-extern uint64_t l2cacheMisses;    // L2$ misses
-extern uint64_t l2cachePenalties; // L2$ penalties
+// A snapshot of the Cache Statistics above
+//
+typedef struct cache_stats
+{
+  uint64_t icacheRefs, icacheMisses, icachePenalties;
+  uint64_t dcacheRefs, dcacheMisses, dcachePenalties;
+  uint64_t l2cacheRefs, l2cacheMisses, l2cachePenalties;
+  uint64_t dcacheWrites, dcacheWritebacks, l2cacheWritebacks;
+  uint64_t l2cacheBytes, memBytes;
+} cache_stats;
+
+//------------------------------------//
+//           Cache Contexts           //
+//------------------------------------//
+
+// A saved cache hierarchy: configuration, contents and statistics.
+// Lets several independent hierarchies take turns in the simulator
+//
+typedef struct cache_context cache_context;
 
 //------------------------------------//
 //      Cache Function Prototypes     //
@@ -70,6 +104,37 @@ extern uint64_t l2cachePenalties; // L2$ penalties
 //
 void init_cache();
 
+// Release the cache data structures allocated by init_cache
+//
+void free_cache();
+
+// Save the current cache hierarchy into 'ctx', allocated if NULL
+// Return the context
+//
+cache_context *cache_save(cache_context *ctx);
+
+// Make the hierarchy saved in 'ctx' the current one. Its contents are
+// shared until the next cache_save, not copied
+//
+void cache_restore(const cache_context *ctx);
+
+// Copy the statistics of the current hierarchy into 'st'
+//
+void cache_stats_read(cache_stats *st);
+
+// Replace the statistics of the current hierarchy with 'st'
+//
+void cache_stats_write(const cache_stats *st);
+
+// Subtract the statistics 'before' from 'st', leaving what happened since
+//
+void cache_stats_sub(cache_stats *st, const cache_stats *before);
+
+// Add every statistic of 'part' times 'scale', rounded, to 'st'
+//
+void cache_stats_add_scaled(cache_stats *st, const cache_stats *part,
+                            double scale);
+
 // Perform a memory access through the icache interface for the address 'addr'
 // Return the access time for the memory operation
 //
@@ -80,9 +145,20 @@ uint32_t icache_access(uint32_t addr);
 //
 uint32_t dcache_access(uint32_t addr);
 
+// Perform a write through the dcache interface for the address 'addr'
+// Return the access time for the memory operation
+//
+uint32_t dcache_write(uint32_t addr);
+
 // Perform a memory access to the l2cache for the address 'addr'
 // Return the access time for the memory operation
 //
 uint32_t l2cache_access(uint32_t addr);
 
+// Perform 'n' memory accesses, directing 'addr[k]' to the icache or the
+// dcache according to 'i_or_d[k]' ('I', 'D' or 'R' for reads, 'W' for writes)
+// Return the total access time for the batch
+//
+uint64_t cache_access_batch(const uint32_t *addr, const char *i_or_d, size_t n);
+
 #endif
@@ -8,11 +8,28 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include "batch.h"
 #include "cache.h"
+#include "results.h"
+#include "serve.h"
+#include "simpoint.h"
+#include "store.h"
+#include "trace.h"
 
 FILE *stream;
 char *buf = NULL;
 size_t len = 0;
+const char *traceFile = NULL;
+uint32_t benchPasses = 0;
+uint32_t simpoint = FALSE;
+simpoint_result simpointResult;
+const char *servePath = NULL;
+const char *batchManifest = NULL;
+const char *batchOutput = NULL;
+
+uint64_t totalRefs = 0;
+uint64_t totalPenalties = 0;
 
 // Print out the Usage information to stderr
 //
@@ -27,17 +44,60 @@ usage()
   fprintf(stderr," --dcache=sets:assoc:hit    D-cache Parameters\n");
   fprintf(stderr," --l2cache=sets:assoc:hit   L2-cache Parameters\n");
   fprintf(stderr," --inclusive                Makes L2-cache be inclusive\n");
+  fprintf(stderr," --dcache-write=wb|wt:wa|nwa\n");
+  fprintf(stderr,"                            D-cache write policy (write-back or\n");
+  fprintf(stderr,"                            write-through, write-allocate or not)\n");
+  fprintf(stderr," --l2cache-write=wb|wt:wa|nwa\n");
+  fprintf(stderr,"                            L2-cache write policy\n");
   fprintf(stderr," --blocksize=size           Block/Line size\n");
   fprintf(stderr," --memspeed=latency         Latency to Main Memory\n");
+  fprintf(stderr," --threads=n                Trace parser and batch threads (0 = one per CPU)\n");
+  fprintf(stderr," --bench=passes             Simulate the trace from memory 'passes' times\n");
+  fprintf(stderr," --simpoint[=interval:k:warmup]\n");
+  fprintf(stderr,"                            Simulate one interval per phase and\n");
+  fprintf(stderr,"                            estimate the statistics of the trace\n");
+  fprintf(stderr," --simpoint-error           Also simulate a random interval per phase\n");
+  fprintf(stderr,"                            to estimate the error of --simpoint\n");
+  fprintf(stderr," --serve=socket             Simulate batches sent to a Unix socket\n");
+  fprintf(stderr," --batch=manifest           Simulate every trace of the manifest under\n");
+  fprintf(stderr,"                            every configuration of the manifest\n");
+  fprintf(stderr," --batch-out=file           Write the batch results to file (.csv or .json)\n");
+  fprintf(stderr," --resultcache=dir          Directory of the result cache\n");
+  fprintf(stderr," --no-resultcache           Don't use the result cache\n");
+  fprintf(stderr," --refresh-resultcache      Resimulate and replace the cached result\n");
+}
+
+// Parse a write policy of the form "wb|wt:wa|nwa"
+//
+// Returns True if Successful
+//
+int
+parse_write_policy(const char *policy, uint32_t *writeBack, uint32_t *writeAlloc)
+{
+  char back[4], alloc[4];
+  if (sscanf(policy, "%3[a-z]:%3[a-z]", back, alloc) != 2) {
+    return 0;
+  }
+  if (!strcmp(back,"wb") || !strcmp(back,"wt")) {
+    *writeBack = !strcmp(back,"wb");
+  } else {
+    return 0;
+  }
+  if (!strcmp(alloc,"wa") || !strcmp(alloc,"nwa")) {
+    *writeAlloc = !strcmp(alloc,"wa");
+  } else {
+    return 0;
+  }
+  return 1;
 }
 
-// Process an option and update the cache
+// Process an option of the cache hierarchy and update the cache
 // configuration variables accordingly
 //
 // Returns True if Successful
 //
 int
-handle_option(char *arg)
+handle_cache_option(char *arg)
 {
   if (!strncmp(arg,"--icache=",9)) {
     sscanf(arg+9,"%u:%u:%u", &icacheSets, &icacheAssoc, &icacheHitTime);
@@ -47,6 +107,10 @@ handle_option(char *arg)
     sscanf(arg+10,"%u:%u:%u", &l2cacheSets, &l2cacheAssoc, &l2cacheHitTime);
   } else if (!strcmp(arg,"--inclusive")) {
     inclusive = TRUE;
+  } else if (!strncmp(arg,"--dcache-write=",15)) {
+    return parse_write_policy(arg+15, &dcacheWriteBack, &dcacheWriteAlloc);
+  } else if (!strncmp(arg,"--l2cache-write=",16)) {
+    return parse_write_policy(arg+16, &l2cacheWriteBack, &l2cacheWriteAlloc);
   } else if (!strncmp(arg,"--blocksize=",12)) {
     sscanf(arg+12,"%u", &blocksize);
   } else if (!strncmp(arg,"--memspeed=",11)) {
@@ -58,100 +122,176 @@ handle_option(char *arg)
   return 1;
 }
 
+// Process an option and update the cache configuration or the
+// simulator settings accordingly
+//
+// Returns True if Successful
+//
+int
+handle_option(char *arg)
+{
+  if (handle_cache_option(arg)) {
+    return 1;
+  } else if (!strncmp(arg,"--threads=",10)) {
+    sscanf(arg+10,"%u", &traceThreads);
+  } else if (!strncmp(arg,"--bench=",8)) {
+    sscanf(arg+8,"%u", &benchPasses);
+  } else if (!strcmp(arg,"--simpoint")) {
+    simpoint = TRUE;
+  } else if (!strcmp(arg,"--simpoint-error")) {
+    simpoint = TRUE;
+    simpointErrorCheck = TRUE;
+  } else if (!strncmp(arg,"--simpoint=",11)) {
+    simpoint = TRUE;
+    sscanf(arg+11,"%u:%u:%u", &simpointInterval, &simpointClusters,
+        &simpointWarmup);
+  } else if (!strncmp(arg,"--serve=",8)) {
+    servePath = arg+8;
+  } else if (!strncmp(arg,"--batch=",8)) {
+    batchManifest = arg+8;
+  } else if (!strncmp(arg,"--batch-out=",12)) {
+    batchOutput = arg+12;
+  } else if (!strncmp(arg,"--resultcache=",14)) {
+    resultCacheDir = arg+14;
+  } else if (!strcmp(arg,"--no-resultcache")) {
+    resultCacheMode = RESULTS_OFF;
+  } else if (!strcmp(arg,"--refresh-resultcache")) {
+    resultCacheMode = RESULTS_REFRESH;
+  } else {
+    return 0;
+  }
+
+  return 1;
+}
+
 void
-printStudentInfo()
+printStudentInfo(FILE *out)
 {
-  printf("Student Name:   %s\n", studentName);
-  printf("Student ID:     %s\n", studentID);
-  printf("Student email:  %s\n", email);
+  fprintf(out,"Student Name:   %s\n", studentName);
+  fprintf(out,"Student ID:     %s\n", studentID);
+  fprintf(out,"Student email:  %s\n", email);
 }
 
 // Print out the memory hierarchy
 //
 void
-printCacheConfig()
+printCacheConfig(FILE *out)
 {
-  printf("Simulator Memory Hierarchy:\n");
+  fprintf(out,"Simulator Memory Hierarchy:\n");
   // Print I$ Configuration
   if (icacheSets) {
-    printf("  I$ Configuration:\n");
-    printf("    Size:  %u KB\n", icacheSets * icacheAssoc * blocksize / 1024);
-    printf("    Sets:  %u\n", icacheSets);
-    printf("    Assoc: %u\n", icacheAssoc);
-    printf("    Lat:   %u Cycles\n", icacheHitTime);
+    fprintf(out,"  I$ Configuration:\n");
+    fprintf(out,"    Size:  %u KB\n", icacheSets * icacheAssoc * blocksize / 1024);
+    fprintf(out,"    Sets:  %u\n", icacheSets);
+    fprintf(out,"    Assoc: %u\n", icacheAssoc);
+    fprintf(out,"    Lat:   %u Cycles\n", icacheHitTime);
   }
   // Print D$ Configuration
   if (dcacheSets) {
-    printf("  D$ Configuration:\n");
-    printf("    Size:  %u KB\n", dcacheSets * dcacheAssoc * blocksize / 1024);
-    printf("    Sets:  %u\n", dcacheSets);
-    printf("    Assoc: %u\n", dcacheAssoc);
-    printf("    Lat:   %u Cycles\n", dcacheHitTime);
+    fprintf(out,"  D$ Configuration:\n");
+    fprintf(out,"    Size:  %u KB\n", dcacheSets * dcacheAssoc * blocksize / 1024);
+    fprintf(out,"    Sets:  %u\n", dcacheSets);
+    fprintf(out,"    Assoc: %u\n", dcacheAssoc);
+    fprintf(out,"    Lat:   %u Cycles\n", dcacheHitTime);
   }
   // Print L2$ Configuration
   if (l2cacheSets) {
-    printf("  L2$ Configuration:\n");
-    printf("    Size:  %u KB\n", l2cacheSets * l2cacheAssoc * blocksize / 1024);
-    printf("    Sets:  %u\n", l2cacheSets);
-    printf("    Assoc: %u\n", l2cacheAssoc);
-    printf("    Lat:   %u Cycles\n", l2cacheHitTime);
-    printf("    Inclusive: %s\n", inclusive ? "Yes" : "No");
-  }
-  printf("  Block Size: %u Bytes\n", blocksize);
-  printf("  Memspeed:   %u Cycles\n", memspeed);
+    fprintf(out,"  L2$ Configuration:\n");
+    fprintf(out,"    Size:  %u KB\n", l2cacheSets * l2cacheAssoc * blocksize / 1024);
+    fprintf(out,"    Sets:  %u\n", l2cacheSets);
+    fprintf(out,"    Assoc: %u\n", l2cacheAssoc);
+    fprintf(out,"    Lat:   %u Cycles\n", l2cacheHitTime);
+    fprintf(out,"    Inclusive: %s\n", inclusive ? "Yes" : "No");
+  }
+  fprintf(out,"  Block Size: %u Bytes\n", blocksize);
+  fprintf(out,"  Memspeed:   %u Cycles\n", memspeed);
 }
 
 // Print out the Cache Statistics
 //
 void
-printCacheStats()
+printCacheStats(FILE *out)
 {
-  printf("Cache Statistics:\n");
+  fprintf(out,"Cache Statistics:\n");
   if (icacheSets) {
-    printf("  total I-cache accesses:  %10lu\n", icacheRefs);
-    printf("  total I-cache misses:    %10lu\n", icacheMisses);
-    printf("  total I-cache penalties: %10lu\n", icachePenalties);
+    fprintf(out,"  total I-cache accesses:  %10lu\n", icacheRefs);
+    fprintf(out,"  total I-cache misses:    %10lu\n", icacheMisses);
+    fprintf(out,"  total I-cache penalties: %10lu\n", icachePenalties);
     if (icacheRefs > 0) {
-      printf("  I-cache miss rate:   %17.2f%%\n",
+      fprintf(out,"  I-cache miss rate:   %17.2f%%\n",
           100.0*(double)icacheMisses/(double)icacheRefs);
-      printf("  avg I-cache access time: %13.2f cycles\n",
+      fprintf(out,"  avg I-cache access time: %13.2f cycles\n",
           (double)((icachePenalties + icacheRefs * icacheHitTime))/icacheRefs);
     } else {
-      printf("  I-cache miss rate:                -\n");
-      printf("  avg I-cache access time:          -\n");
+      fprintf(out,"  I-cache miss rate:                -\n");
+      fprintf(out,"  avg I-cache access time:          -\n");
     }
   }
   if (dcacheSets) {
-    printf("  total D-cache accesses:  %10lu\n", dcacheRefs);
-    printf("  total D-cache misses:    %10lu\n", dcacheMisses);
-    printf("  total D-cache penalties: %10lu\n", dcachePenalties);
+    fprintf(out,"  total D-cache accesses:  %10lu\n", dcacheRefs);
+    fprintf(out,"  total D-cache misses:    %10lu\n", dcacheMisses);
+    fprintf(out,"  total D-cache penalties: %10lu\n", dcachePenalties);
     if (dcacheRefs > 0) {
-      printf("  D-cache miss rate:   %17.2f%%\n",
+      fprintf(out,"  D-cache miss rate:   %17.2f%%\n",
           100.0*(double)dcacheMisses/(double)dcacheRefs);
-      printf("  avg D-cache access time: %13.2f cycles\n",
+      fprintf(out,"  avg D-cache access time: %13.2f cycles\n",
           (double)((dcachePenalties + dcacheRefs * dcacheHitTime))/dcacheRefs);
     } else {
-      printf("  D-cache miss rate:                -\n");
-      printf("  avg D-cache access time:          -\n");
+      fprintf(out,"  D-cache miss rate:                -\n");
+      fprintf(out,"  avg D-cache access time:          -\n");
     }
   }
   if (l2cacheSets) {
-    printf("  total L2-cache accesses: %10lu\n", l2cacheRefs);
-    printf("  total L2-cache misses:   %10lu\n", l2cacheMisses);
-    printf("  total L2-cache penalties:%10lu\n", l2cachePenalties);
+    fprintf(out,"  total L2-cache accesses: %10lu\n", l2cacheRefs);
+    fprintf(out,"  total L2-cache misses:   %10lu\n", l2cacheMisses);
+    fprintf(out,"  total L2-cache penalties:%10lu\n", l2cachePenalties);
     if (l2cacheRefs > 0) {
-      printf("  L2-cache miss rate:  %17.2f%%\n",
+      fprintf(out,"  L2-cache miss rate:  %17.2f%%\n",
           100.0*(double)l2cacheMisses/(double)l2cacheRefs);
-      printf("  avg L2-cache access time:%13.2f cycles\n",
+      fprintf(out,"  avg L2-cache access time:%13.2f cycles\n",
           (double)((l2cachePenalties + l2cacheHitTime * l2cacheRefs))
           / l2cacheRefs);
     } else {
-      printf("  L2-cache miss rate:               -\n");
-      printf("  avg L2-cache access time:         -\n");
+      fprintf(out,"  L2-cache miss rate:               -\n");
+      fprintf(out,"  avg L2-cache access time:         -\n");
     }
   }
 }
 
+// Print out the write traffic of the hierarchy and the memory
+// bandwidth it demands
+//
+void
+printTrafficStats(FILE *out)
+{
+  fprintf(out,"Traffic Statistics:\n");
+  if (dcacheSets) {
+    fprintf(out,"  D$ Write Policy: %s, %s\n",
+        dcacheWriteBack ? "write-back" : "write-through",
+        dcacheWriteAlloc ? "write-allocate" : "no-write-allocate");
+  }
+  if (l2cacheSets) {
+    fprintf(out,"  L2$ Write Policy: %s, %s\n",
+        l2cacheWriteBack ? "write-back" : "write-through",
+        l2cacheWriteAlloc ? "write-allocate" : "no-write-allocate");
+  }
+  fprintf(out,"  total data writes:       %10lu\n", dcacheWrites);
+  if (dcacheSets) {
+    fprintf(out,"  D-cache write-backs:     %10lu\n", dcacheWritebacks);
+  }
+  if (l2cacheSets) {
+    fprintf(out,"  L2-cache write-backs:    %10lu\n", l2cacheWritebacks);
+    fprintf(out,"  bytes L1 <-> L2-cache:   %10lu\n", l2cacheBytes);
+  }
+  fprintf(out,"  bytes to/from memory:    %10lu\n", memBytes);
+  if (totalPenalties > 0) {
+    fprintf(out,"  memory bandwidth demand: %13.2f bytes/cycle\n",
+        (double)memBytes / totalPenalties);
+  } else {
+    fprintf(out,"  memory bandwidth demand:          -\n");
+  }
+}
+
 // Set the defaults for the Cache Simulator
 //
 void
@@ -173,25 +313,232 @@ set_defaults()
   inclusive       = 0;
   blocksize       = 16;
   memspeed        = 50;
+
+  // Set default Write Policies
+  dcacheWriteBack   = TRUE;
+  dcacheWriteAlloc  = TRUE;
+  l2cacheWriteBack  = TRUE;
+  l2cacheWriteAlloc = TRUE;
+
+  // Set default Trace Parameters
+  traceThreads    = 0;
+
+  // Set default SimPoint Parameters
+  simpointInterval = SIMPOINT_INTERVAL;
+  simpointClusters = SIMPOINT_CLUSTERS;
+  simpointWarmup   = SIMPOINT_WARMUP;
+  simpointErrorCheck = FALSE;
+
+  // Set default Result Cache Parameters
+  resultCacheDir  = NULL;
+  resultCacheMode = RESULTS_ON;
 }
 
 // Reads a line from the input stream and extracts the
-// Address and where the mem access should be directed to (I$ or D$)
+// Address and where the mem access should be directed to (I$ or D$).
+// Blank lines are skipped, 'line' counts every line read
 //
-// Returns True if Successful 
+// Returns True if Successful, False at the end of the stream. A malformed
+// line is reported with its line number and terminates the simulator
 //
 int
-read_mem_access(uint32_t *addr, char *i_or_d)
+read_mem_access(uint32_t *addr, char *i_or_d, uint64_t *line)
 {
-  if (getline(&buf, &len, stream) == -1) {
-    return 0;
+  do {
+    if (getline(&buf, &len, stream) == -1) {
+      return 0;
+    }
+    (*line)++;
+  } while (!strcmp(buf,"\n") || !strcmp(buf,"\r\n") || !strcmp(buf,"\r"));
+
+  *i_or_d = '\0';
+  int fields = sscanf(buf,"0x%x %c\n",addr,i_or_d);
+  if (fields < 1) {
+    fprintf(stderr,"Input Error malformed address (line %lu)\n", *line);
+    exit(1);
+  }
+  if (*i_or_d != 'I' && *i_or_d != 'D' && *i_or_d != 'R' && *i_or_d != 'W') {
+    fprintf(stderr,"Input Error '%c' must be one of 'I', 'D', 'R' or 'W' "
+        "(line %lu)\n", *i_or_d, *line);
+    exit(1);
   }
 
-  sscanf(buf,"0x%x %c\n",addr,i_or_d);
+  return 1;
+}
+
+// Print the full simulator output
+//
+void
+printResults(FILE *out)
+{
+  printStudentInfo(out);
+  printCacheConfig(out);
+  printCacheStats(out);
+  fprintf(out,"Total Memory accesses:  %lu\n", totalRefs);
+  fprintf(out,"Total Memory penalties: %lu\n", totalPenalties);
+  if (totalRefs > 0) {
+    fprintf(out,"avg Memory access time: %13.2f cycles\n",
+        (double)totalPenalties / totalRefs);
+  } else {
+    fprintf(out,"avg Memory access time:             -\n");
+  }
+  // Only traces with writes have traffic worth reporting
+  if (dcacheWrites > 0) {
+    printTrafficStats(out);
+  }
+}
 
+// Print how the SimPoint estimate was obtained
+//
+void
+printSimpointStats(FILE *out)
+{
+  fprintf(out,"SimPoint Statistics:\n");
+  fprintf(out,"  intervals:               %10lu\n", simpointResult.intervals);
+  fprintf(out,"  clusters:                %10u\n", simpointResult.clusters);
+  fprintf(out,"  simulated accesses:      %10lu\n", simpointResult.simulated);
+  if (totalRefs > 0) {
+    fprintf(out,"  simulated fraction:  %17.2f%%\n",
+        100.0*(double)simpointResult.simulated/(double)totalRefs);
+  }
+  if (totalRefs > 0 && simpointErrorCheck) {
+    fprintf(out,"  avg access time error:  +-%11.2f%% (approx. 95%%)\n",
+        simpointResult.error);
+  }
+}
+
+// Build the result cache key of this run: the trace fingerprint and the
+// configuration, with the parameters of uninstantiated caches dropped
+//
+// Returns True if the run can be cached (the trace is a regular file)
+//
+int
+result_key(char *key, size_t size)
+{
+  uint64_t hash, bytes;
+  if (!traceFile || benchPasses || resultCacheMode == RESULTS_OFF ||
+      !results_fingerprint(traceFile, &hash, &bytes)) {
+    return 0;
+  }
+
+  snprintf(key, size, "trace=%016lx:%lu icache=%u:%u:%u dcache=%u:%u:%u "
+      "l2cache=%u:%u:%u inclusive=%u blocksize=%u memspeed=%u "
+      "write=%u%u:%u%u",
+      hash, bytes,
+      icacheSets, icacheSets ? icacheAssoc : 0, icacheSets ? icacheHitTime : 0,
+      dcacheSets, dcacheSets ? dcacheAssoc : 0, dcacheSets ? dcacheHitTime : 0,
+      l2cacheSets, l2cacheSets ? l2cacheAssoc : 0,
+      l2cacheSets ? l2cacheHitTime : 0, l2cacheSets ? inclusive : 0,
+      blocksize, memspeed, dcacheWriteBack, dcacheWriteAlloc,
+      l2cacheWriteBack, l2cacheWriteAlloc);
+  if (simpoint) {
+    size_t used = strlen(key);
+    snprintf(key + used, size - used, " simpoint=%u:%u:%u:%u",
+        simpointInterval, simpointClusters, simpointWarmup,
+        simpointErrorCheck);
+  }
   return 1;
 }
 
+// Simulate a batch of memory accesses decoded by the trace parser
+//
+void
+process_batch(const uint32_t *addr, const char *i_or_d, size_t n, void *arg)
+{
+  totalRefs += n;
+  totalPenalties += cache_access_batch(addr, i_or_d, n);
+}
+
+// Read every memory access from the trace and pass it on to 'fn'.
+// Files are mapped and parsed in parallel, anything else (stdin, pipes)
+// is read one line at a time
+//
+void
+read_trace(trace_batch_fn fn, void *arg)
+{
+  if (traceFile && trace_parse_file(traceFile, fn, arg)) {
+    return;
+  }
+  if (traceFile) {
+    stream = fopen(traceFile, "r");
+    if (!stream) {
+      fprintf(stderr,"Unable to open trace file %s\n", traceFile);
+      exit(1);
+    }
+  }
+
+  uint64_t line = 0;
+  uint32_t addr = 0;
+  char i_or_d = '\0';
+
+  while (read_mem_access(&addr, &i_or_d, &line)) {
+    fn(&addr, &i_or_d, 1, arg);
+  }
+  fclose(stream);
+  stream = NULL;
+}
+
+// Load the trace into memory and estimate its statistics from a sample
+// of its phases
+//
+void
+run_simpoint()
+{
+  trace_store *ts = store_new();
+  read_trace(store_append, ts);
+  store_finish(ts);
+
+  simpoint_run(ts, &simpointResult);
+  totalRefs = simpointResult.refs;
+  totalPenalties = simpointResult.penalties;
+
+  store_free(ts);
+}
+
+// Load the trace into memory once and simulate it 'benchPasses' times,
+// reporting the size of the trace store and the time of every pass
+//
+void
+run_bench()
+{
+  trace_store *ts = store_new();
+  read_trace(store_append, ts);
+  store_finish(ts);
+
+  uint64_t raw = ts->refs * (sizeof(uint32_t) + sizeof(char));
+  fprintf(stderr,"Trace store: %lu refs in %lu bytes (%.1f%% of %lu raw)\n",
+      ts->refs, store_bytes(ts),
+      raw ? 100.0 * (double)store_bytes(ts) / (double)raw : 0.0, raw);
+
+  uint32_t *addr = (uint32_t *)malloc(STORE_CHUNK * sizeof(uint32_t));
+  char *i_or_d = (char *)malloc(STORE_CHUNK);
+
+  for (uint32_t pass = 0; pass < benchPasses; pass++) {
+    if (pass) {
+      free_cache();
+      init_cache();
+    }
+    totalRefs = 0;
+    totalPenalties = 0;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint64_t c = 0; c < store_chunks(ts); c++) {
+      uint32_t n = store_decode(ts, c, addr, i_or_d);
+      process_batch(addr, i_or_d, n, NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    fprintf(stderr,"Pass %u: %.3f s (%.1f M refs/s)\n", pass + 1, secs,
+        secs > 0 ? (double)totalRefs / secs / 1e6 : 0.0);
+  }
+
+  free(addr);
+  free(i_or_d);
+  store_free(ts);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -211,47 +558,65 @@ main(int argc, char *argv[])
       }
     } else {
       // Use as input file
-      stream = fopen(argv[i], "r");
+      traceFile = argv[i];
     }
   }
 
-  // Initialize the cache
-  init_cache();
+  // Run as a daemon, the configuration is the default of every session
+  if (servePath) {
+    init_cache();
+    int ok = serve(servePath, handle_cache_option);
+    free_cache();
+    return ok ? 0 : 1;
+  }
 
-  uint64_t totalRefs = 0;
-  uint64_t totalPenalties = 0;
-  uint32_t addr = 0;
-  char i_or_d = '\0';
+  // Run the jobs of the manifest, the configuration is the default of
+  // every config
+  if (batchManifest) {
+    return batch_run(batchManifest, batchOutput, handle_cache_option) ? 0 : 1;
+  }
 
-  // Read each memory access from the trace
-  while (read_mem_access(&addr, &i_or_d)) {
-    totalRefs++;
-    // Direct the memory access to the appropriate cache
-    if (i_or_d == 'I') {
-      totalPenalties += icache_access(addr);
-    } else if (i_or_d == 'D') {
-      totalPenalties += dcache_access(addr);
-    } else {
-      fprintf(stderr,"Input Error '%c' must be either 'I' or 'D'\n", i_or_d);
-      exit(1);
+  // Return the stored output if this exact run was simulated before
+  char key[512];
+  int cacheable = result_key(key, sizeof(key));
+  if (cacheable) {
+    size_t len;
+    char *output = results_lookup(key, &len);
+    if (output) {
+      fwrite(output, 1, len, stdout);
+      free(output);
+      return 0;
     }
   }
 
-  // Print out the statistics
-  printStudentInfo();
-  printCacheConfig();
-  printCacheStats();
-  printf("Total Memory accesses:  %lu\n", totalRefs);
-  printf("Total Memory penalties: %lu\n", totalPenalties);
-  if (totalRefs > 0) {
-    printf("avg Memory access time: %13.2f cycles\n",
-        (double)totalPenalties / totalRefs);
+  // Initialize the cache
+  init_cache();
+
+  if (benchPasses) {
+    run_bench();
+  } else if (simpoint) {
+    run_simpoint();
   } else {
-    printf("avg Memory access time:             -\n");
+    read_trace(process_batch, NULL);
+  }
+
+  // Print out the statistics
+  char *output = NULL;
+  size_t len = 0;
+  FILE *out = open_memstream(&output, &len);
+  printResults(out);
+  if (simpoint) {
+    printSimpointStats(out);
   }
+  fclose(out);
+  fwrite(output, 1, len, stdout);
+  if (cacheable) {
+    results_store(key, output, len);
+  }
+  free(output);
 
   // Cleanup
-  fclose(stream);
+  free_cache();
   free(buf);
 
   return 0;
@@ -0,0 +1,225 @@
+//========================================================//
+//  results.c                                             //
+//  Source file for the persistent result cache           //
+//                                                        //
+//  Each result is a file named after the hash of its     //
+//  key, starting with the full key to catch collisions   //
+//========================================================//
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "results.h"
+
+//------------------------------------//
+//     Result Cache Configuration     //
+//------------------------------------//
+
+const char *resultCacheDir; // Directory of the result cache
+uint32_t resultCacheMode;   // One of RESULTS_ON, RESULTS_OFF, RESULTS_REFRESH
+
+//------------------------------------//
+//            Hashing                 //
+//------------------------------------//
+
+#define PRIME1 0x9e3779b185ebca87ULL
+#define PRIME2 0xc2b2ae3d27d4eb4fULL
+
+static inline uint64_t
+rotl64(uint64_t x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t
+mix64(uint64_t h)
+{
+  h ^= h >> 33;
+  h *= PRIME2;
+  h ^= h >> 29;
+  h *= PRIME1;
+  h ^= h >> 32;
+  return h;
+}
+
+// Hash 'len' bytes with four independent lanes so the multiplies overlap
+//
+static uint64_t
+hash_bytes(const uint8_t *p, uint64_t len)
+{
+  uint64_t h[4] = { PRIME1, PRIME2, ~PRIME1, ~PRIME2 };
+  uint64_t i = 0;
+
+  for (; i + 32 <= len; i += 32) {
+    for (int l = 0; l < 4; l++) {
+      uint64_t w;
+      memcpy(&w, p + i + 8 * l, sizeof(w));
+      h[l] = rotl64(h[l] ^ (w * PRIME2), 31) * PRIME1;
+    }
+  }
+
+  uint64_t r = rotl64(h[0], 1) + rotl64(h[1], 7) + rotl64(h[2], 12)
+             + rotl64(h[3], 18);
+  for (; i < len; i++) {
+    r = (r ^ p[i]) * PRIME1;
+  }
+  return mix64(r ^ len);
+}
+
+int
+results_fingerprint(const char *path, uint64_t *hash, uint64_t *size)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+  struct stat st;
+  if (fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return 0;
+  }
+
+  *size = st.st_size;
+  if (st.st_size == 0) {
+    *hash = hash_bytes(NULL, 0);
+    close(fd);
+    return 1;
+  }
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return 0;
+  }
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+  *hash = hash_bytes((const uint8_t *)data, st.st_size);
+  munmap(data, st.st_size);
+  return 1;
+}
+
+//------------------------------------//
+//          Result Files              //
+//------------------------------------//
+
+// Directory of the result cache, created on first use.
+// Returns NULL if there is none
+//
+static const char *
+cache_dir()
+{
+  static char dir[4096];
+
+  if (!dir[0]) {
+    const char *env = getenv("CACHE240A_RESULTS");
+    const char *home = getenv("HOME");
+    if (resultCacheDir) {
+      snprintf(dir, sizeof(dir), "%s", resultCacheDir);
+    } else if (env && env[0]) {
+      snprintf(dir, sizeof(dir), "%s", env);
+    } else if (home && home[0]) {
+      snprintf(dir, sizeof(dir), "%s/.cache/cache240a", home);
+    } else {
+      return NULL;
+    }
+
+    // mkdir -p
+    for (char *p = dir + 1; *p; p++) {
+      if (*p == '/') {
+        *p = '\0';
+        mkdir(dir, 0755);
+        *p = '/';
+      }
+    }
+    if (mkdir(dir, 0755) && errno != EEXIST) {
+      dir[0] = '\0';
+      return NULL;
+    }
+  }
+  return dir;
+}
+
+// The simulator binary itself is part of every key, so rebuilding it
+// never serves results computed by an older version
+//
+static void
+result_path(const char *key, char *path, size_t size, char *header,
+            size_t hsize)
+{
+  struct stat st;
+  uint64_t build = 0;
+  if (!stat("/proc/self/exe", &st)) {
+    build = mix64((uint64_t)st.st_mtim.tv_sec * PRIME1
+                  ^ (uint64_t)st.st_mtim.tv_nsec * PRIME2 ^ st.st_size);
+  } else {
+    const char *stamp = __DATE__ " " __TIME__;
+    build = hash_bytes((const uint8_t *)stamp, strlen(stamp));
+  }
+
+  snprintf(header, hsize, "%s build=%016lx\n", key, build);
+  snprintf(path, size, "%s/%016lx", cache_dir(),
+      hash_bytes((const uint8_t *)header, strlen(header)));
+}
+
+char *
+results_lookup(const char *key, size_t *len)
+{
+  char path[4200], header[1024];
+  if (resultCacheMode != RESULTS_ON || !cache_dir()) {
+    return NULL;
+  }
+  result_path(key, path, sizeof(path), header, sizeof(header));
+
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    return NULL;
+  }
+  char *buf = NULL;
+  size_t cap = 0;
+  ssize_t hlen = getline(&buf, &cap, f);
+  if (hlen < 0 || strcmp(buf, header)) {
+    free(buf);
+    fclose(f);
+    return NULL;
+  }
+
+  // The rest of the file is the output
+  long start = ftell(f);
+  fseek(f, 0, SEEK_END);
+  long end = ftell(f);
+  fseek(f, start, SEEK_SET);
+  char *output = (char *)realloc(buf, end - start + 1);
+  *len = fread(output, 1, end - start, f);
+  fclose(f);
+  if (*len != (size_t)(end - start)) {
+    free(output);
+    return NULL;
+  }
+  return output;
+}
+
+void
+results_store(const char *key, const char *output, size_t len)
+{
+  char path[4200], tmp[4300], header[1024];
+  if (resultCacheMode == RESULTS_OFF || !cache_dir()) {
+    return;
+  }
+  result_path(key, path, sizeof(path), header, sizeof(header));
+
+  // Write to a private file and rename it so readers never see a
+  // partial result
+  snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+  FILE *f = fopen(tmp, "w");
+  if (!f) {
+    return;
+  }
+  int ok = fputs(header, f) >= 0 && fwrite(output, 1, len, f) == len;
+  ok = !fclose(f) && ok;
+  if (!ok || rename(tmp, path)) {
+    unlink(tmp);
+  }
+}
@@ -0,0 +1,47 @@
+//========================================================//
+//  results.h                                             //
+//  Header file for the persistent result cache           //
+//                                                        //
+//  Remembers the output of a simulation under the trace  //
+//  fingerprint and the cache configuration               //
+//========================================================//
+
+#ifndef RESULTS_H
+#define RESULTS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+//------------------------------------//
+//     Result Cache Configuration     //
+//------------------------------------//
+
+extern const char *resultCacheDir; // Directory of the result cache
+extern uint32_t resultCacheMode;   // One of the modes below
+
+#define RESULTS_ON      0  // Return cached results, store new ones
+#define RESULTS_OFF     1  // Bypass the result cache
+#define RESULTS_REFRESH 2  // Recompute and overwrite cached results
+
+//------------------------------------//
+//  Result Cache Function Prototypes  //
+//------------------------------------//
+
+// Compute the content fingerprint of the trace file at 'path', a 64-bit
+// hash of every byte plus its size.
+//
+// Returns True if Successful, False if 'path' is not a regular file
+//
+int results_fingerprint(const char *path, uint64_t *hash, uint64_t *size);
+
+// Look up the output stored under 'key'
+// Return a malloc'ed copy of the output or NULL on a miss
+//
+char *results_lookup(const char *key, size_t *len);
+
+// Store 'len' bytes of 'output' under 'key'. Failures are ignored, the
+// result cache is only an accelerator
+//
+void results_store(const char *key, const char *output, size_t len);
+
+#endif
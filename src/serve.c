@@ -0,0 +1,487 @@
+//========================================================//
+//  serve.c                                               //
+//  Source file for the simulation daemon                 //
+//                                                        //
+//  A single thread polls the clients and switches the    //
+//  simulator between the cache contexts of the sessions  //
+//========================================================//
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "cache.h"
+#include "serve.h"
+
+//------------------------------------//
+//       Daemon Data Structures       //
+//------------------------------------//
+
+#define SERVE_MAX_CLIENTS 64
+#define SERVE_MAX_QUEUED  (1 << 20)  // Reply bytes before a client is not read
+
+typedef struct session
+{
+  struct session *next;
+  char name[SERVE_MAX_NAME + 1];
+  cache_context *ctx;       // Saved hierarchy, stale while current
+  uint64_t refs;            // Memory accesses since opened
+  uint64_t penalties;       // Memory penalties since opened
+} session;
+
+typedef struct client
+{
+  int fd;
+  uint8_t *buf;             // Bytes of the request being received
+  size_t size, cap;
+  uint8_t *out;             // Reply bytes not yet accepted by the socket
+  size_t outSize, outCap;
+  int eof;                  // The client sent its last request
+  int failed;               // Protocol error, dropped once its replies are sent
+} client;
+
+static session *sessions;
+static session *current;    // Session whose hierarchy the simulator holds
+static cache_context *defaults;
+static volatile sig_atomic_t stop;
+
+//------------------------------------//
+//             Sessions               //
+//------------------------------------//
+
+static session *
+find_session(const char *name)
+{
+  for (session *s = sessions; s; s = s->next) {
+    if (!strcmp(s->name, name)) {
+      return s;
+    }
+  }
+  return NULL;
+}
+
+// Load the hierarchy of 's' into the simulator
+//
+static void
+switch_to(session *s)
+{
+  if (current == s) {
+    return;
+  }
+  if (current) {
+    cache_save(current->ctx);
+  }
+  cache_restore(s->ctx);
+  current = s;
+}
+
+// Create a session with the default configuration plus 'options'
+//
+static uint32_t
+open_session(const char *name, char *options, int (*option)(char *arg),
+             session **out)
+{
+  if (current) {
+    cache_save(current->ctx);
+    current = NULL;
+  }
+  cache_restore(defaults);
+
+  char *save = NULL;
+  for (char *arg = options ? strtok_r(options, " \t\n", &save) : NULL; arg;
+       arg = strtok_r(NULL, " \t\n", &save)) {
+    if (!option(arg)) {
+      return SERVE_EOPTION;
+    }
+  }
+
+  session *s = (session *)calloc(1, sizeof(session));
+  snprintf(s->name, sizeof(s->name), "%s", name);
+  init_cache();
+  s->ctx = cache_save(NULL);
+  s->next = sessions;
+  sessions = s;
+  current = s;
+  *out = s;
+  return SERVE_OK;
+}
+
+static void
+close_session(session *s)
+{
+  switch_to(s);
+  free_cache();
+  current = NULL;
+
+  for (session **p = &sessions; *p; p = &(*p)->next) {
+    if (*p == s) {
+      *p = s->next;
+      break;
+    }
+  }
+  free(s->ctx);
+  free(s);
+}
+
+// Statistics of the current session
+//
+static void
+read_stats(const session *s, serve_stats *st)
+{
+  st->refs      = s->refs;
+  st->penalties = s->penalties;
+  cache_stats_read(&st->cache);
+}
+
+//------------------------------------//
+//             Requests               //
+//------------------------------------//
+
+static size_t
+padded(size_t nameLen)
+{
+  return (nameLen + 7) & ~(size_t)7;
+}
+
+// Bytes of the whole request, header included
+//
+static size_t
+request_size(const serve_request *rq)
+{
+  size_t size = sizeof(serve_request) + padded(rq->nameLen);
+  if (rq->op == SERVE_OPEN) {
+    size += rq->count;
+  } else if (rq->op == SERVE_BATCH) {
+    size += (size_t)rq->count * (sizeof(uint32_t) + sizeof(char));
+  }
+  return size;
+}
+
+static void
+handle_request(serve_request *rq, int (*option)(char *arg), serve_reply *rp)
+{
+  char name[SERVE_MAX_NAME + 1];
+  uint8_t *payload = (uint8_t *)(rq + 1) + padded(rq->nameLen);
+  memcpy(name, rq + 1, rq->nameLen);
+  name[rq->nameLen] = '\0';
+
+  session *s = find_session(name);
+  if (rq->op == SERVE_OPEN) {
+    if (s) {
+      rp->status = SERVE_EEXIST;
+      return;
+    }
+    char *options = (char *)malloc(rq->count + 1);
+    memcpy(options, payload, rq->count);
+    options[rq->count] = '\0';
+    rp->status = open_session(name, options, option, &s);
+    free(options);
+    if (rp->status != SERVE_OK) {
+      return;
+    }
+  } else if (rq->op == SERVE_BATCH) {
+    const uint32_t *addr = (const uint32_t *)payload;
+    const char *i_or_d = (const char *)(addr + rq->count);
+    for (uint32_t k = 0; k < rq->count; k++) {
+      if (i_or_d[k] != 'I' && i_or_d[k] != 'D' && i_or_d[k] != 'R' &&
+          i_or_d[k] != 'W') {
+        rp->status = SERVE_EINPUT;
+        return;
+      }
+    }
+    if (!s) {
+      open_session(name, NULL, option, &s);
+    }
+
+    // Same hot path as a trace file
+    cache_stats before;
+    switch_to(s);
+    cache_stats_read(&before);
+    rp->batch.refs = rq->count;
+    rp->batch.penalties = cache_access_batch(addr, i_or_d, rq->count);
+    s->refs += rp->batch.refs;
+    s->penalties += rp->batch.penalties;
+    cache_stats_read(&rp->batch.cache);
+    cache_stats_sub(&rp->batch.cache, &before);
+  } else if (!s) {
+    rp->status = SERVE_ENOENT;
+    return;
+  } else if (rq->op == SERVE_RESET) {
+    switch_to(s);
+    free_cache();
+    init_cache();
+    s->refs = 0;
+    s->penalties = 0;
+  } else if (rq->op == SERVE_CLOSE) {
+    switch_to(s);
+    read_stats(s, &rp->total);
+    close_session(s);
+    return;
+  } else if (rq->op != SERVE_STATS) {
+    rp->status = SERVE_EPROTO;
+    return;
+  }
+
+  switch_to(s);
+  read_stats(s, &rp->total);
+}
+
+//------------------------------------//
+//              Clients               //
+//------------------------------------//
+
+static void
+queue_reply(client *c, const serve_reply *rp)
+{
+  if (c->outCap - c->outSize < sizeof(*rp)) {
+    c->outCap = c->outCap ? 2 * c->outCap : 4096;
+    c->out = (uint8_t *)realloc(c->out, c->outCap);
+  }
+  memcpy(c->out + c->outSize, rp, sizeof(*rp));
+  c->outSize += sizeof(*rp);
+}
+
+// Write as many queued replies as the socket takes without blocking.
+// Returns False once the client should be dropped
+//
+static int
+flush_client(client *c)
+{
+  size_t sent = 0;
+  while (sent < c->outSize) {
+    ssize_t n = write(c->fd, c->out + sent, c->outSize - sent);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    }
+    if (n <= 0) {
+      return 0;
+    }
+    sent += n;
+  }
+  memmove(c->out, c->out + sent, c->outSize - sent);
+  c->outSize -= sent;
+  return 1;
+}
+
+// Read what the client sent without blocking.
+// Returns False once the client should be dropped
+//
+static int
+read_client(client *c)
+{
+  if (c->cap - c->size < 65536) {
+    c->cap = c->cap ? 2 * c->cap : 65536;
+    c->buf = (uint8_t *)realloc(c->buf, c->cap);
+  }
+  ssize_t n = read(c->fd, c->buf + c->size, c->cap - c->size);
+  if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+    return 1;
+  }
+  if (n < 0) {
+    return 0;
+  }
+  if (n == 0) {
+    c->eof = 1;
+  }
+  c->size += n;
+  return 1;
+}
+
+// Answer the complete requests received so far, until 'limit' reply
+// bytes are queued.
+// Returns the number of requests answered
+//
+static int
+process_requests(client *c, int (*option)(char *arg), size_t limit)
+{
+  size_t used = 0;
+  int answered = 0;
+  while (!c->failed && c->outSize < limit &&
+         c->size - used >= sizeof(serve_request)) {
+    // Requests and their payloads must stay aligned
+    if (used % 8) {
+      memmove(c->buf, c->buf + used, c->size - used);
+      c->size -= used;
+      used = 0;
+    }
+    serve_request *rq = (serve_request *)(c->buf + used);
+    serve_reply rp;
+    memset(&rp, 0, sizeof(rp));
+    rp.magic = SERVE_MAGIC;
+
+    if (rq->magic != SERVE_MAGIC || rq->nameLen > SERVE_MAX_NAME ||
+        rq->count > SERVE_MAX_BATCH) {
+      rp.status = SERVE_EPROTO;
+      queue_reply(c, &rp);
+      c->failed = 1;
+      break;
+    }
+    size_t size = request_size(rq);
+    if (c->size - used < size) {
+      break;
+    }
+
+    handle_request(rq, option, &rp);
+    queue_reply(c, &rp);
+    used += size;
+    answered++;
+  }
+  memmove(c->buf, c->buf + used, c->size - used);
+  c->size -= used;
+  return answered;
+}
+
+// Read, answer and write what the client is ready for.
+// Returns False once the client should be dropped
+//
+static int
+service_client(client *c, short revents, int (*option)(char *arg))
+{
+  if (revents & (POLLERR | POLLNVAL)) {
+    return 0;
+  }
+  if ((revents & (POLLIN | POLLHUP)) && !c->eof && !read_client(c)) {
+    return 0;
+  }
+
+  // Requests held back by a full queue are answered as soon as it drains,
+  // the client may not send anything else until then. Past its last
+  // request a client is no longer throttled
+  for (;;) {
+    size_t limit = c->eof ? (size_t)-1 : SERVE_MAX_QUEUED;
+    int answered = process_requests(c, option, limit);
+    if (c->outSize && !flush_client(c)) {
+      return 0;
+    }
+    if (!answered || c->outSize) {
+      break;
+    }
+  }
+  return c->outSize || !(c->eof || c->failed);
+}
+
+static void
+drop_client(client *c)
+{
+  close(c->fd);
+  free(c->buf);
+  free(c->out);
+}
+
+static void
+on_signal(int sig)
+{
+  stop = 1;
+}
+
+int
+serve(const char *path, int (*option)(char *arg))
+{
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr,"Socket path too long: %s\n", path);
+    return 0;
+  }
+  strcpy(addr.sun_path, path);
+
+  // Only a stale socket is replaced, never any other file
+  struct stat st;
+  if (!lstat(path, &st)) {
+    if (!S_ISSOCK(st.st_mode)) {
+      fprintf(stderr,"Unable to listen on %s: not a socket\n", path);
+      return 0;
+    }
+    unlink(path);
+  }
+
+  int lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (lfd < 0 || bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) ||
+      listen(lfd, SERVE_MAX_CLIENTS)) {
+    fprintf(stderr,"Unable to listen on %s: %s\n", path, strerror(errno));
+    if (lfd >= 0) {
+      close(lfd);
+    }
+    return 0;
+  }
+
+  // SIGINT and SIGTERM are only delivered inside ppoll, so a signal
+  // can't slip in between the check of 'stop' and the wait
+  struct sigaction sa;
+  sigset_t block, wait;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = on_signal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+  sigemptyset(&block);
+  sigaddset(&block, SIGINT);
+  sigaddset(&block, SIGTERM);
+  sigprocmask(SIG_BLOCK, &block, &wait);
+
+  // The hierarchy configured on the command line, never simulated
+  defaults = cache_save(NULL);
+
+  struct pollfd pfd[SERVE_MAX_CLIENTS + 1];
+  client clients[SERVE_MAX_CLIENTS];
+  int nclients = 0;
+
+  while (!stop) {
+    pfd[0].fd = lfd;
+    pfd[0].events = POLLIN;
+    for (int i = 0; i < nclients; i++) {
+      client *c = &clients[i];
+      pfd[i + 1].fd = c->fd;
+      pfd[i + 1].events = 0;
+      if (!c->eof && !c->failed && c->outSize < SERVE_MAX_QUEUED) {
+        pfd[i + 1].events |= POLLIN;
+      }
+      if (c->outSize) {
+        pfd[i + 1].events |= POLLOUT;
+      }
+    }
+    if (ppoll(pfd, nclients + 1, NULL, &wait) < 0) {
+      continue;
+    }
+
+    for (int i = nclients - 1; i >= 0; i--) {
+      short revents = pfd[i + 1].revents;
+      if (revents && !service_client(&clients[i], revents, option)) {
+        drop_client(&clients[i]);
+        clients[i] = clients[--nclients];
+      }
+    }
+    if (pfd[0].revents & POLLIN) {
+      int fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK);
+      if (fd >= 0 && nclients == SERVE_MAX_CLIENTS) {
+        close(fd);
+      } else if (fd >= 0) {
+        memset(&clients[nclients], 0, sizeof(client));
+        clients[nclients++].fd = fd;
+      }
+    }
+  }
+
+  for (int i = 0; i < nclients; i++) {
+    drop_client(&clients[i]);
+  }
+  while (sessions) {
+    close_session(sessions);
+  }
+  cache_restore(defaults);
+  free(defaults);
+  close(lfd);
+  unlink(path);
+  sigprocmask(SIG_SETMASK, &wait, NULL);
+  return 1;
+}
@@ -0,0 +1,87 @@
+//========================================================//
+//  serve.h                                               //
+//  Header file for the simulation daemon                 //
+//                                                        //
+//  Keeps cache hierarchies resident and simulates        //
+//  batches of accesses sent over a Unix domain socket    //
+//========================================================//
+
+#ifndef SERVE_H
+#define SERVE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "cache.h"
+
+//------------------------------------//
+//             Protocol               //
+//------------------------------------//
+
+// Every request is a serve_request followed by the session name, padded
+// with zeros to a multiple of 8 bytes, and a payload:
+//
+//   SERVE_OPEN   'count' bytes of options, e.g. "--icache=128:2:2 --inclusive"
+//   SERVE_BATCH  'count' uint32_t addresses, then 'count' I/D/R/W flags
+//   others       nothing
+//
+// Every request is answered with one serve_reply, in order. Requests may
+// be pipelined, but a client is not read while 1 MB of its replies are
+// unread. Integers are in the byte order of the host
+//
+#define SERVE_MAGIC     0x32344143  // "CA42"
+
+#define SERVE_OPEN      1  // Create a session, options override the defaults
+#define SERVE_BATCH     2  // Simulate a batch, the session is opened if needed
+#define SERVE_STATS     3  // Report the statistics of the session
+#define SERVE_RESET     4  // Empty the caches and clear the statistics
+#define SERVE_CLOSE     5  // Drop the session
+
+#define SERVE_OK        0
+#define SERVE_EPROTO    1  // Malformed request
+#define SERVE_ENOENT    2  // No such session
+#define SERVE_EEXIST    3  // Session already open
+#define SERVE_EOPTION   4  // Unrecognized option
+#define SERVE_EINPUT    5  // Flag other than 'I', 'D', 'R' or 'W', batch ignored
+
+#define SERVE_MAX_NAME  255
+#define SERVE_MAX_BATCH (1u << 20)
+
+typedef struct serve_request
+{
+  uint32_t magic;
+  uint16_t op;
+  uint16_t nameLen;         // Length of the session name
+  uint32_t count;           // Length of the payload, see above
+  uint32_t reserved;
+} serve_request;
+
+typedef struct serve_stats
+{
+  uint64_t refs;            // Memory accesses
+  uint64_t penalties;       // Memory penalties
+  cache_stats cache;        // Cache statistics, 14 uint64_t in cache.h order
+} serve_stats;
+
+typedef struct serve_reply
+{
+  uint32_t magic;
+  uint32_t status;          // SERVE_OK or an error
+  serve_stats batch;        // Statistics of this batch (SERVE_BATCH only)
+  serve_stats total;        // Statistics since the session was opened
+} serve_reply;
+
+//------------------------------------//
+//      Daemon Function Prototypes    //
+//------------------------------------//
+
+// Serve requests on the Unix domain socket 'path' until SIGINT or SIGTERM.
+// The current cache configuration is the default of every session,
+// 'option' applies the options of SERVE_OPEN to it and must accept only
+// options of the cache hierarchy. An existing file at 'path' is only
+// replaced if it is a socket.
+//
+// Returns True if Successful
+//
+int serve(const char *path, int (*option)(char *arg));
+
+#endif
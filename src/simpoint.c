@@ -0,0 +1,354 @@
+//========================================================//
+//  simpoint.c                                            //
+//  Source file for phase-based sampled simulation        //
+//                                                        //
+//  Pass 1 hashes the block addresses of every interval   //
+//  into a signature and clusters them with k-means.      //
+//  Pass 2 simulates one representative per cluster and   //
+//  weighs its statistics by the size of the cluster      //
+//========================================================//
+
+#include <math.h>
+#include <string.h>
+#include "cache.h"
+#include "simpoint.h"
+
+//------------------------------------//
+//       SimPoint Configuration       //
+//------------------------------------//
+
+uint32_t simpointInterval;  // References per interval
+uint32_t simpointClusters;  // Maximum number of clusters (k)
+uint32_t simpointWarmup;    // References simulated before an interval
+uint32_t simpointErrorCheck; // Also simulate a random member per cluster
+
+//------------------------------------//
+//       SimPoint Data Structures     //
+//------------------------------------//
+
+// Width of the interval signatures
+//
+#define SIG_DIM 32
+
+#define KMEANS_ITERATIONS 100
+
+// Statistics of one simulated interval
+//
+typedef struct interval_stats
+{
+  uint64_t refs;            // Memory accesses
+  uint64_t penalties;       // Memory penalties
+  cache_stats cache;
+} interval_stats;
+
+typedef struct simpoint_state
+{
+  const trace_store *ts;
+  uint64_t chunks;          // Chunks in the trace
+  uint64_t ichunks;         // Chunks per interval
+  uint64_t wchunks;         // Chunks of warmup
+  uint32_t *addr;           // Decoding buffers
+  char *i_or_d;
+  uint64_t simulated;       // References simulated so far
+} simpoint_state;
+
+//------------------------------------//
+//        Pass 1: Clustering          //
+//------------------------------------//
+
+// Reproducible pseudo random numbers in [0, 1)
+//
+static double
+next_random(uint64_t *seed)
+{
+  *seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return (double)(*seed >> 11) / (double)(1ULL << 53);
+}
+
+static double
+distance(const double *a, const double *b)
+{
+  double d = 0;
+  for (int j = 0; j < SIG_DIM; j++) {
+    d += (a[j] - b[j]) * (a[j] - b[j]);
+  }
+  return d;
+}
+
+// Build the normalized block address histogram of every interval
+//
+static double *
+build_signatures(simpoint_state *st, uint64_t nint)
+{
+  double *sig = (double *)calloc(nint * SIG_DIM, sizeof(double));
+  uint32_t shift = 0;
+  while ((1u << shift) < blocksize) {
+    shift++;
+  }
+
+  for (uint64_t i = 0; i < nint; i++) {
+    double *v = sig + i * SIG_DIM;
+    uint64_t refs = 0;
+    for (uint64_t c = i * st->ichunks;
+         c < st->chunks && c < (i + 1) * st->ichunks; c++) {
+      uint32_t n = store_decode(st->ts, c, st->addr, st->i_or_d);
+      for (uint32_t k = 0; k < n; k++) {
+        uint32_t h = (st->addr[k] >> shift) ^ (st->i_or_d[k] == 'I' ? 0 : 0x5bd1e995u);
+        v[(h * 0x9e3779b1u) >> 27]++;
+      }
+      refs += n;
+    }
+    for (int j = 0; j < SIG_DIM; j++) {
+      v[j] /= (double)refs;
+    }
+  }
+  return sig;
+}
+
+// Cluster the signatures with k-means, seeded with k-means++.
+// Return the number of clusters, 'assign' holds the cluster of each interval
+//
+static uint32_t
+cluster(const double *sig, uint64_t nint, uint32_t k, double *cent,
+        uint32_t *assign)
+{
+  double *d = (double *)malloc(nint * sizeof(double));
+  uint64_t seed = 240;
+  uint32_t found = 1;
+
+  memcpy(cent, sig + (uint64_t)(next_random(&seed) * nint) * SIG_DIM,
+         SIG_DIM * sizeof(double));
+  for (uint64_t i = 0; i < nint; i++) {
+    d[i] = distance(sig + i * SIG_DIM, cent);
+  }
+  while (found < k) {
+    double sum = 0;
+    for (uint64_t i = 0; i < nint; i++) {
+      sum += d[i];
+    }
+    if (sum == 0) {
+      break;
+    }
+    double r = next_random(&seed) * sum;
+    uint64_t pick = 0;
+    while (pick + 1 < nint && (r -= d[pick]) >= 0) {
+      pick++;
+    }
+    double *c = cent + (uint64_t)found * SIG_DIM;
+    memcpy(c, sig + pick * SIG_DIM, SIG_DIM * sizeof(double));
+    found++;
+    for (uint64_t i = 0; i < nint; i++) {
+      double di = distance(sig + i * SIG_DIM, c);
+      d[i] = (di < d[i]) ? di : d[i];
+    }
+  }
+  free(d);
+
+  uint64_t *members = (uint64_t *)malloc(found * sizeof(uint64_t));
+  for (int iter = 0; iter < KMEANS_ITERATIONS; iter++) {
+    int changed = 0;
+    for (uint64_t i = 0; i < nint; i++) {
+      uint32_t best = 0;
+      double bestd = distance(sig + i * SIG_DIM, cent);
+      for (uint32_t c = 1; c < found; c++) {
+        double dc = distance(sig + i * SIG_DIM, cent + (uint64_t)c * SIG_DIM);
+        if (dc < bestd) {
+          bestd = dc;
+          best = c;
+        }
+      }
+      changed |= (iter == 0 || assign[i] != best);
+      assign[i] = best;
+    }
+    if (!changed) {
+      break;
+    }
+
+    // Move the centroids, an empty cluster keeps its old one
+    memset(members, 0, found * sizeof(uint64_t));
+    for (uint64_t i = 0; i < nint; i++) {
+      members[assign[i]]++;
+    }
+    for (uint32_t c = 0; c < found; c++) {
+      if (members[c]) {
+        memset(cent + (uint64_t)c * SIG_DIM, 0, SIG_DIM * sizeof(double));
+      }
+    }
+    for (uint64_t i = 0; i < nint; i++) {
+      double *c = cent + (uint64_t)assign[i] * SIG_DIM;
+      for (int j = 0; j < SIG_DIM; j++) {
+        c[j] += sig[i * SIG_DIM + j] / (double)members[assign[i]];
+      }
+    }
+  }
+  free(members);
+  return found;
+}
+
+//------------------------------------//
+//        Pass 2: Simulation          //
+//------------------------------------//
+
+// Simulate interval 'i' after a functional warmup that starts at chunk
+// 'warm'. The caches keep whatever the previous sample left in them,
+// which is closer to the real state than cold caches.
+// 'delta' receives the statistics of the interval alone
+//
+static void
+simulate_interval(simpoint_state *st, uint64_t i, uint64_t warm,
+                  interval_stats *delta)
+{
+  uint64_t first = i * st->ichunks;
+  uint64_t last = (first + st->ichunks < st->chunks)
+                ? first + st->ichunks : st->chunks;
+  cache_stats before;
+
+  for (uint64_t c = warm; c < last; c++) {
+    if (c == first) {
+      cache_stats_read(&before);
+      delta->refs = 0;
+      delta->penalties = 0;
+    }
+    uint32_t n = store_decode(st->ts, c, st->addr, st->i_or_d);
+    delta->refs += n;
+    delta->penalties += cache_access_batch(st->addr, st->i_or_d, n);
+    st->simulated += n;
+  }
+
+  cache_stats_read(&delta->cache);
+  cache_stats_sub(&delta->cache, &before);
+}
+
+void
+simpoint_run(const trace_store *ts, simpoint_result *res)
+{
+  simpoint_state st;
+  st.ts = ts;
+  st.chunks = store_chunks(ts);
+  st.ichunks = (simpointInterval + STORE_CHUNK - 1) / STORE_CHUNK;
+  st.ichunks = st.ichunks ? st.ichunks : 1;
+  st.wchunks = ((uint64_t)simpointWarmup + STORE_CHUNK - 1) / STORE_CHUNK;
+  st.simulated = 0;
+
+  uint64_t nint = (st.chunks + st.ichunks - 1) / st.ichunks;
+  memset(res, 0, sizeof(*res));
+  res->intervals = nint;
+  if (nint == 0) {
+    return;
+  }
+
+  st.addr = (uint32_t *)malloc(STORE_CHUNK * sizeof(uint32_t));
+  st.i_or_d = (char *)malloc(STORE_CHUNK);
+
+  // Pass 1
+  uint32_t k = simpointClusters ? simpointClusters : 1;
+  k = (k < nint) ? k : (uint32_t)nint;
+  double *sig = build_signatures(&st, nint);
+  double *cent = (double *)malloc((uint64_t)k * SIG_DIM * sizeof(double));
+  uint32_t *assign = (uint32_t *)malloc(nint * sizeof(uint32_t));
+  k = cluster(sig, nint, k, cent, assign);
+
+  // Pick the interval closest to each centroid as its representative
+  uint64_t *rep = (uint64_t *)malloc(k * sizeof(uint64_t));
+  uint64_t *check = (uint64_t *)malloc(k * sizeof(uint64_t));
+  uint64_t *crefs = (uint64_t *)calloc(k, sizeof(uint64_t));
+  uint64_t *others = (uint64_t *)calloc(k, sizeof(uint64_t));
+  double *repd = (double *)malloc(k * sizeof(double));
+  for (uint32_t c = 0; c < k; c++) {
+    repd[c] = INFINITY;
+  }
+  for (uint64_t i = 0; i < nint; i++) {
+    uint32_t c = assign[i];
+    double d = distance(sig + i * SIG_DIM, cent + (uint64_t)c * SIG_DIM);
+    uint64_t first = i * st.ichunks * STORE_CHUNK;
+    uint64_t len = (uint64_t)st.ichunks * STORE_CHUNK;
+    crefs[c] += (ts->refs - first < len) ? ts->refs - first : len;
+    if (d < repd[c]) {
+      repd[c] = d;
+      rep[c] = i;
+    }
+  }
+
+  // On request, draw one other member of each cluster at random to
+  // estimate the spread within the cluster. This simulates up to twice
+  // as many intervals
+  uint64_t seed = 240;
+  for (uint64_t i = 0; simpointErrorCheck && i < nint; i++) {
+    uint32_t c = assign[i];
+    if (i != rep[c] && next_random(&seed) * ++others[c] < 1.0) {
+      check[c] = i;
+    }
+  }
+
+  // Pass 2, in trace order so every sample warms up the next one
+  uint64_t *sampled = (uint64_t *)calloc(nint, sizeof(uint64_t));
+  for (uint32_t c = 0; c < k; c++) {
+    if (crefs[c]) {
+      res->clusters++;
+      sampled[rep[c]] = 1;
+      if (others[c]) {
+        sampled[check[c]] = 1;
+      }
+    }
+  }
+
+  double *x = (double *)calloc(nint, sizeof(double));
+  cache_stats est;
+  double estPenalties = 0;
+  memset(&est, 0, sizeof(est));
+  uint64_t done = 0;
+  free_cache();
+  init_cache();
+  for (uint64_t i = 0; i < nint; i++) {
+    if (!sampled[i]) {
+      continue;
+    }
+    interval_stats delta;
+    uint64_t first = i * st.ichunks;
+    uint64_t warm = (first > done + st.wchunks) ? first - st.wchunks : done;
+    simulate_interval(&st, i, warm, &delta);
+    done = first + st.ichunks;
+    x[i] = (double)delta.penalties / (double)delta.refs;
+
+    uint32_t c = assign[i];
+    if (i == rep[c]) {
+      double scale = (double)crefs[c] / (double)delta.refs;
+      cache_stats_add_scaled(&est, &delta.cache, scale);
+      estPenalties += scale * (double)delta.penalties;
+    }
+  }
+
+  // Stratified sampling variance of the avg access time, with the
+  // variance of each cluster estimated from its representative and the
+  // random member. Clusters with a single interval have no sampling error
+  double var = 0;
+  for (uint32_t c = 0; c < k; c++) {
+    if (crefs[c] && others[c]) {
+      double w = (double)crefs[c] / (double)ts->refs;
+      double dx = x[rep[c]] - x[check[c]];
+      var += w * w * dx * dx / 2;
+    }
+  }
+
+  cache_stats_write(&est);
+  res->refs = ts->refs;
+  res->penalties = (uint64_t)llround(estPenalties);
+  res->simulated = st.simulated;
+  if (simpointErrorCheck && estPenalties > 0) {
+    res->error = 100.0 * 1.96 * sqrt(var)
+               / (estPenalties / (double)ts->refs);
+  }
+
+  free(st.addr);
+  free(st.i_or_d);
+  free(sig);
+  free(cent);
+  free(assign);
+  free(rep);
+  free(check);
+  free(crefs);
+  free(others);
+  free(repd);
+  free(sampled);
+  free(x);
+}
@@ -0,0 +1,57 @@
+//========================================================//
+//  simpoint.h                                            //
+//  Header file for phase-based sampled simulation        //
+//                                                        //
+//  Clusters the intervals of a trace by their block      //
+//  address signature and simulates one per cluster       //
+//========================================================//
+
+#ifndef SIMPOINT_H
+#define SIMPOINT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "store.h"
+
+//------------------------------------//
+//       SimPoint Configuration       //
+//------------------------------------//
+
+extern uint32_t simpointInterval;  // References per interval
+extern uint32_t simpointClusters;  // Maximum number of clusters (k)
+extern uint32_t simpointWarmup;    // References simulated before an interval
+extern uint32_t simpointErrorCheck; // Also simulate a random member per cluster
+                                    // to estimate the error
+
+// Interval and warmup lengths are rounded up to whole store chunks
+//
+#define SIMPOINT_INTERVAL 1048576
+#define SIMPOINT_CLUSTERS 10
+#define SIMPOINT_WARMUP   131072
+
+//------------------------------------//
+//        SimPoint Statistics         //
+//------------------------------------//
+
+typedef struct simpoint_result
+{
+  uint64_t intervals;       // Intervals in the trace
+  uint32_t clusters;        // Clusters found
+  uint64_t simulated;       // References simulated, warmup included
+  uint64_t refs;            // Estimated total memory accesses
+  uint64_t penalties;       // Estimated total memory penalties
+  double   error;           // Approximate 95% confidence of the avg access
+                            // time in %, only with simpointErrorCheck
+} simpoint_result;
+
+//------------------------------------//
+//    SimPoint Function Prototypes    //
+//------------------------------------//
+
+// Estimate the statistics of simulating all of 'ts' from a sample of its
+// intervals. The cache hierarchy must be initialized; on return the cache
+// statistics hold the weighted estimates for the whole trace
+//
+void simpoint_run(const trace_store *ts, simpoint_result *res);
+
+#endif
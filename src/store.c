@@ -0,0 +1,256 @@
+//========================================================//
+//  store.c                                               //
+//  Source file for the in-memory trace store             //
+//                                                        //
+//  The I$ and D$ accesses are kept in two streams of     //
+//  varint-coded deltas with runs of repeated deltas      //
+//  folded into one token, plus one I/D bit per reference //
+//  and, once the trace has writes, one write bit         //
+//========================================================//
+
+#include <string.h>
+#include "store.h"
+
+//------------------------------------//
+//          Stream Encoding           //
+//------------------------------------//
+
+// A token is either a literal delta, (zigzag(delta) << 1), or a run
+// repeating the previous delta, (count << 1) | 1. Sequential code is a
+// single run of +4 deltas between two jumps
+//
+
+static void
+stream_put(store_stream *s, uint64_t token)
+{
+  if (s->size + 10 > s->cap) {
+    s->cap = s->cap ? 2 * s->cap : 4096;
+    s->bytes = (uint8_t *)realloc(s->bytes, s->cap);
+  }
+  while (token >= 0x80) {
+    s->bytes[s->size++] = (uint8_t)(token | 0x80);
+    token >>= 7;
+  }
+  s->bytes[s->size++] = (uint8_t)token;
+}
+
+static void
+stream_flush(store_stream *s)
+{
+  if (s->run) {
+    stream_put(s, (s->run << 1) | 1);
+    s->run = 0;
+  }
+}
+
+static inline void
+stream_append(store_stream *s, uint32_t addr)
+{
+  int32_t d = (int32_t)(addr - s->prev);
+  s->prev = addr;
+  if (d == s->delta) {
+    s->run++;
+    return;
+  }
+  stream_flush(s);
+  stream_put(s, (uint64_t)(((uint32_t)d << 1) ^ (uint32_t)(d >> 31)) << 1);
+  s->delta = d;
+}
+
+// Decoding state of one stream within a chunk
+//
+typedef struct stream_cursor
+{
+  const uint8_t *p;
+  uint32_t prev;
+  int32_t  delta;
+  uint64_t run;
+} stream_cursor;
+
+static inline uint32_t
+cursor_next(stream_cursor *c)
+{
+  if (c->run) {
+    c->run--;
+    return c->prev += c->delta;
+  }
+
+  uint64_t token = 0;
+  int shift = 0;
+  uint8_t b;
+  do {
+    b = *c->p++;
+    token |= (uint64_t)(b & 0x7f) << shift;
+    shift += 7;
+  } while (b & 0x80);
+
+  if (token & 1) {
+    c->run = (token >> 1) - 1;
+  } else {
+    uint32_t z = (uint32_t)(token >> 1);
+    c->delta = (int32_t)((z >> 1) ^ (0u - (z & 1)));
+  }
+  return c->prev += c->delta;
+}
+
+//------------------------------------//
+//          Store Functions           //
+//------------------------------------//
+
+trace_store *
+store_new()
+{
+  return (trace_store *)calloc(1, sizeof(trace_store));
+}
+
+void
+store_free(trace_store *ts)
+{
+  if (!ts) {
+    return;
+  }
+  free(ts->isD);
+  free(ts->isW);
+  free(ts->chunk);
+  free(ts->istream.bytes);
+  free(ts->dstream.bytes);
+  free(ts);
+}
+
+// Close the runs of the previous chunk and index the next one. Deltas
+// restart from 0 so every chunk decodes on its own
+//
+static void
+start_chunk(trace_store *ts)
+{
+  uint64_t c = ts->refs / STORE_CHUNK;
+
+  stream_flush(&ts->istream);
+  stream_flush(&ts->dstream);
+  ts->istream.delta = 0;
+  ts->dstream.delta = 0;
+
+  if (c >= ts->chunkCap) {
+    ts->chunkCap = ts->chunkCap ? 2 * ts->chunkCap : 64;
+    ts->chunk = (store_chunk *)realloc(ts->chunk,
+                                       ts->chunkCap * sizeof(store_chunk));
+  }
+  ts->chunk[c].ioff  = ts->istream.size;
+  ts->chunk[c].doff  = ts->dstream.size;
+  ts->chunk[c].iprev = ts->istream.prev;
+  ts->chunk[c].dprev = ts->dstream.prev;
+
+  uint64_t words = (c + 1) * (STORE_CHUNK / 64);
+  if (words > ts->isDCap) {
+    uint64_t cap = ts->isDCap ? 2 * ts->isDCap : words;
+    ts->isD = (uint64_t *)realloc(ts->isD, cap * sizeof(uint64_t));
+    memset(ts->isD + ts->isDCap, 0, (cap - ts->isDCap) * sizeof(uint64_t));
+    if (ts->isW) {
+      ts->isW = (uint64_t *)realloc(ts->isW, cap * sizeof(uint64_t));
+      memset(ts->isW + ts->isDCap, 0, (cap - ts->isDCap) * sizeof(uint64_t));
+    }
+    ts->isDCap = cap;
+  }
+}
+
+void
+store_append(const uint32_t *addr, const char *i_or_d, size_t n, void *arg)
+{
+  trace_store *ts = (trace_store *)arg;
+
+  for (size_t k = 0; k < n; k++) {
+    if (ts->refs % STORE_CHUNK == 0) {
+      start_chunk(ts);
+    }
+    if (i_or_d[k] == 'I') {
+      stream_append(&ts->istream, addr[k]);
+    } else {
+      ts->isD[ts->refs >> 6] |= 1ULL << (ts->refs & 63);
+      if (i_or_d[k] == 'W') {
+        // Read-only traces never pay for the write bits
+        if (!ts->isW) {
+          ts->isW = (uint64_t *)calloc(ts->isDCap, sizeof(uint64_t));
+        }
+        ts->isW[ts->refs >> 6] |= 1ULL << (ts->refs & 63);
+      }
+      stream_append(&ts->dstream, addr[k]);
+    }
+    ts->refs++;
+  }
+}
+
+void
+store_finish(trace_store *ts)
+{
+  store_stream *s[2] = { &ts->istream, &ts->dstream };
+
+  // Give back the slack of the doubling growth
+  for (int i = 0; i < 2; i++) {
+    stream_flush(s[i]);
+    if (s[i]->size) {
+      s[i]->bytes = (uint8_t *)realloc(s[i]->bytes, s[i]->size);
+      s[i]->cap = s[i]->size;
+    }
+  }
+}
+
+uint64_t
+store_chunks(const trace_store *ts)
+{
+  return (ts->refs + STORE_CHUNK - 1) / STORE_CHUNK;
+}
+
+uint32_t
+store_decode(const trace_store *ts, uint64_t c, uint32_t *addr, char *i_or_d)
+{
+  uint64_t first = c * STORE_CHUNK;
+  uint32_t n = (ts->refs - first < STORE_CHUNK)
+             ? (uint32_t)(ts->refs - first) : STORE_CHUNK;
+  stream_cursor ic = { ts->istream.bytes + ts->chunk[c].ioff,
+                       ts->chunk[c].iprev, 0, 0 };
+  stream_cursor dc = { ts->dstream.bytes + ts->chunk[c].doff,
+                       ts->chunk[c].dprev, 0, 0 };
+  const uint64_t *isD = ts->isD + first / 64;
+  const uint64_t *isW = ts->isW ? ts->isW + first / 64 : NULL;
+
+  for (uint32_t k = 0; k < n; k += 64) {
+    uint64_t bits = isD[k / 64];
+    uint32_t m = (n - k < 64) ? n - k : 64;
+
+    // Runs of I$ accesses are the common case, skip them a word at a time
+    if (bits == 0) {
+      for (uint32_t j = 0; j < m; j++) {
+        addr[k + j] = cursor_next(&ic);
+        i_or_d[k + j] = 'I';
+      }
+      continue;
+    }
+    for (uint32_t j = 0; j < m; j++) {
+      if ((bits >> j) & 1) {
+        addr[k + j] = cursor_next(&dc);
+        i_or_d[k + j] = 'D';
+      } else {
+        addr[k + j] = cursor_next(&ic);
+        i_or_d[k + j] = 'I';
+      }
+    }
+    if (isW && isW[k / 64]) {
+      uint64_t w = isW[k / 64];
+      for (uint32_t j = 0; j < m; j++) {
+        if ((w >> j) & 1) {
+          i_or_d[k + j] = 'W';
+        }
+      }
+    }
+  }
+  return n;
+}
+
+uint64_t
+store_bytes(const trace_store *ts)
+{
+  return sizeof(trace_store)
+       + ts->isDCap * sizeof(uint64_t) * (ts->isW ? 2 : 1)
+       + ts->chunkCap * sizeof(store_chunk)
+       + ts->istream.cap + ts->dstream.cap;
+}
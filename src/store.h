@@ -0,0 +1,92 @@
+//========================================================//
+//  store.h                                               //
+//  Header file for the in-memory trace store             //
+//                                                        //
+//  Keeps a decoded trace resident in compressed form so  //
+//  it can be simulated many times without the disk       //
+//========================================================//
+
+#ifndef STORE_H
+#define STORE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+//------------------------------------//
+//        Store Data Structures       //
+//------------------------------------//
+
+// References are grouped in chunks that decode independently
+//
+#define STORE_CHUNK 65536
+
+// One delta-encoded address stream (I$ or D$ accesses)
+//
+typedef struct store_stream
+{
+  uint8_t *bytes;           // Varint tokens
+  uint64_t size, cap;       // Bytes used / allocated
+  uint32_t prev;            // Last address appended
+  int32_t  delta;           // Last delta appended
+  uint64_t run;             // Pending repeats of 'delta'
+} store_stream;
+
+// Index entry of a chunk: where each stream resumes and from which address
+//
+typedef struct store_chunk
+{
+  uint64_t ioff, doff;      // Offsets into the I and D streams
+  uint32_t iprev, dprev;    // Last I and D addresses before the chunk
+} store_chunk;
+
+typedef struct trace_store
+{
+  uint64_t refs;            // References stored
+  uint64_t *isD;            // One bit per reference, set for D$ accesses
+  uint64_t *isW;            // One bit per reference, set for D$ writes.
+                            // NULL until the first write is appended
+  uint64_t isDCap;          // Words allocated for 'isD' (and 'isW')
+  store_chunk *chunk;       // Chunk index
+  uint64_t chunkCap;        // Index entries allocated
+  store_stream istream;     // I$ addresses
+  store_stream dstream;     // D$ addresses
+} trace_store;
+
+//------------------------------------//
+//      Store Function Prototypes     //
+//------------------------------------//
+
+// Create an empty store
+//
+trace_store *store_new();
+
+// Release a store and everything it holds
+//
+void store_free(trace_store *ts);
+
+// Append a batch of references to the store 'arg'. Matches trace_batch_fn
+// so a store can be filled straight from trace_parse_file
+//
+void store_append(const uint32_t *addr, const char *i_or_d, size_t n,
+                  void *arg);
+
+// Flush the pending runs. Must be called once all references are appended
+//
+void store_finish(trace_store *ts);
+
+// Number of chunks in the store
+//
+uint64_t store_chunks(const trace_store *ts);
+
+// Decode chunk 'c' into 'addr' and 'i_or_d', which hold STORE_CHUNK entries.
+// Data reads, 'R' or 'D', come back as 'D'
+// Return the number of references decoded
+//
+uint32_t store_decode(const trace_store *ts, uint64_t c, uint32_t *addr,
+                      char *i_or_d);
+
+// Memory held by the store in bytes
+//
+uint64_t store_bytes(const trace_store *ts);
+
+#endif
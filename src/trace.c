@@ -0,0 +1,372 @@
+//========================================================//
+//  trace.c                                               //
+//  Source file for the trace readers                     //
+//                                                        //
+//  Maps a text trace into memory, splits it at newline   //
+//  boundaries and decodes the lines on several threads   //
+//========================================================//
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "trace.h"
+
+//------------------------------------//
+//        Trace Configuration         //
+//------------------------------------//
+
+uint32_t traceThreads;   // Number of parser threads (0 = one per CPU)
+
+//------------------------------------//
+//        Trace Data Structures       //
+//------------------------------------//
+
+// Amount of text decoded per window. Two windows are in flight so the
+// next one is parsed while the simulator consumes the current one
+//
+#define TRACE_WINDOW      (64u << 20)
+#define TRACE_MAX_THREADS 64
+
+// The shortest valid line is "0x0I"
+//
+#define TRACE_MIN_LINE    5
+
+// Kinds of malformed lines
+//
+#define TRACE_OK          0
+#define TRACE_BAD_ADDR    1
+#define TRACE_BAD_FLAG    2
+
+typedef struct trace_chunk
+{
+  const char *begin, *end;  // Text range, starts at the beginning of a line
+  uint32_t *addr;           // Decoded addresses
+  char *i_or_d;             // Decoded I$/D$ flags
+  size_t count, cap;        // References decoded / capacity of the arrays
+  uint64_t lines;           // Lines consumed (up to the error if any)
+  int error;                // TRACE_OK or the kind of malformed line
+  char errorChar;           // The offending flag for TRACE_BAD_FLAG
+  pthread_t thread;
+  int threaded;             // Parsed by 'thread', else already parsed inline
+} trace_chunk;
+
+typedef struct trace_window
+{
+  trace_chunk chunk[TRACE_MAX_THREADS];
+  uint32_t nchunks;
+} trace_window;
+
+//------------------------------------//
+//          Line Decoding             //
+//------------------------------------//
+
+#define ONES  0x0101010101010101ULL
+#define HIGHS 0x8080808080808080ULL
+
+// Sets the high bit of every byte of 'x' (all bytes < 0x80) that lies
+// in the range [lo, hi]
+//
+static inline uint64_t
+swar_in_range(uint64_t x, uint8_t lo, uint8_t hi)
+{
+  uint64_t ge_lo = (x + ONES * (0x80 - lo)) & HIGHS;
+  uint64_t gt_hi = (x + ONES * (0x7f - hi)) & HIGHS;
+  return ge_lo & ~gt_hi;
+}
+
+static inline uint64_t
+load64(const char *p)
+{
+  uint64_t w;
+  memcpy(&w, p, sizeof(w));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  w = __builtin_bswap64(w);
+#endif
+  return w;
+}
+
+// Decode up to 8 hex digits held in the low bytes of 'w' (first digit in
+// the lowest byte), 8 digits at a time without branching per digit.
+// 'w' holds the bytes following "0x" on the line.
+//
+// Returns the number of digits before the first space (8 if there is none
+// in 'w'), 0 if there are no digits or they contain a non-hex character
+//
+static inline int
+swar_parse_hex(uint64_t w, uint32_t *addr)
+{
+  // Locate the first space
+  uint64_t t = w ^ (ONES * ' ');
+  uint64_t z = (t - ONES) & ~t & HIGHS;
+  int n = z ? (__builtin_ctzll(z) >> 3) : 8;
+  if (n == 0) {
+    return 0;
+  }
+  uint64_t m = (n == 8) ? ~0ULL : ((1ULL << (8 * n)) - 1);
+
+  // Every byte before the space must be [0-9a-fA-F]
+  uint64_t ascii = ~w & HIGHS;
+  uint64_t valid = swar_in_range(w, '0', '9')
+                 | swar_in_range(w | (ONES * 0x20), 'a', 'f');
+  if (((valid & ascii) & m & HIGHS) != (m & HIGHS)) {
+    return 0;
+  }
+
+  // Convert each byte to its nibble value and right align the digits
+  uint64_t v = (w & (ONES * 0x0f)) + 9 * ((w >> 6) & ONES);
+  v = (v & m) << (8 * (8 - n));
+
+  // Fold the nibbles, most significant digit sits in the lowest byte
+  v = ((v & 0x000f000f000f000fULL) << 4) | ((v & 0x0f000f000f000f00ULL) >> 8);
+  v = ((v & 0x000000ff000000ffULL) << 8) | ((v & 0x00ff000000ff0000ULL) >> 16);
+  *addr = (uint32_t)(((v & 0xffff) << 16) | ((v >> 32) & 0xffff));
+
+  return n;
+}
+
+// Instruction fetch, data access, data read or data write
+//
+static inline int
+valid_flag(char f)
+{
+  return f == 'I' || f == 'D' || f == 'R' || f == 'W';
+}
+
+// Decode a line the way main.c's sscanf("0x%x %c") does. Used for the
+// lines that don't have the canonical "0x<1-8 digits> <flag>\n" shape
+//
+static int
+parse_line_slow(const char *p, const char *eol, uint32_t *addr, char *i_or_d)
+{
+  if (eol - p < 3 || p[0] != '0' || p[1] != 'x') {
+    return TRACE_BAD_ADDR;
+  }
+  p += 2;
+
+  uint32_t a = 0;
+  const char *digits = p;
+  for (; p < eol; p++) {
+    char c = *p;
+    if (c >= '0' && c <= '9') {
+      a = (a << 4) | (uint32_t)(c - '0');
+    } else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+      a = (a << 4) | (uint32_t)((c | 0x20) - 'a' + 10);
+    } else {
+      break;
+    }
+  }
+  if (p == digits) {
+    return TRACE_BAD_ADDR;
+  }
+  while (p < eol && (*p == ' ' || *p == '\t' || *p == '\r')) {
+    p++;
+  }
+
+  *addr = a;
+  *i_or_d = (p < eol) ? *p : '\0';
+  return valid_flag(*i_or_d) ? TRACE_OK : TRACE_BAD_FLAG;
+}
+
+// Decode every line in the chunk. Runs on its own thread
+//
+static void *
+parse_chunk(void *arg)
+{
+  trace_chunk *c = (trace_chunk *)arg;
+  const char *p = c->begin;
+  const char *end = c->end;
+  size_t count = 0;
+  uint64_t lines = 0;
+
+  while (p < end) {
+    uint32_t a;
+    char f = '\0';
+    lines++;
+
+    // Fast path: "0x" + up to 8 digits + ' ' + flag + '\n' fits in 13 bytes
+    if (end - p >= 16 && p[0] == '0' && p[1] == 'x') {
+      int n = swar_parse_hex(load64(p + 2), &a);
+      if (n && p[n + 2] == ' ' && p[n + 4] == '\n') {
+        f = p[n + 3];
+        if (!valid_flag(f)) {
+          c->error = TRACE_BAD_FLAG;
+          c->errorChar = f;
+          break;
+        }
+        c->addr[count] = a;
+        c->i_or_d[count] = f;
+        count++;
+        p += n + 5;
+        continue;
+      }
+    }
+
+    const char *eol = memchr(p, '\n', end - p);
+    if (!eol) {
+      eol = end;
+    }
+    // Blank lines are skipped, as in main.c's read_mem_access
+    if (eol > p && !(eol - p == 1 && *p == '\r')) {
+      int err = parse_line_slow(p, eol, &a, &f);
+      if (err != TRACE_OK) {
+        c->error = err;
+        c->errorChar = f;
+        break;
+      }
+      c->addr[count] = a;
+      c->i_or_d[count] = f;
+      count++;
+    }
+    p = eol + 1;
+  }
+
+  c->count = count;
+  c->lines = lines;
+  return NULL;
+}
+
+//------------------------------------//
+//          Trace Functions           //
+//------------------------------------//
+
+// Split [begin, end) into 'nthreads' chunks at line boundaries and start
+// parsing them
+//
+static void
+start_window(trace_window *w, const char *begin, const char *end,
+             uint32_t nthreads)
+{
+  size_t step = (size_t)(end - begin) / nthreads + 1;
+  const char *p = begin;
+
+  w->nchunks = 0;
+  while (p < end) {
+    trace_chunk *c = &w->chunk[w->nchunks++];
+    const char *q = (w->nchunks == nthreads || (size_t)(end - p) <= step)
+                  ? end : p + step;
+    if (q < end) {
+      const char *nl = memchr(q, '\n', end - q);
+      q = nl ? nl + 1 : end;
+    }
+
+    size_t cap = (size_t)(q - p) / TRACE_MIN_LINE + 1;
+    if (cap > c->cap) {
+      free(c->addr);
+      free(c->i_or_d);
+      c->addr = (uint32_t *)malloc(cap * sizeof(uint32_t));
+      c->i_or_d = (char *)malloc(cap);
+      c->cap = cap;
+    }
+    c->begin = p;
+    c->end = q;
+    c->count = 0;
+    c->lines = 0;
+    c->error = TRACE_OK;
+    // Out of threads, parse it right away
+    c->threaded = !pthread_create(&c->thread, NULL, parse_chunk, c);
+    if (!c->threaded) {
+      parse_chunk(c);
+    }
+    p = q;
+  }
+}
+
+// Window boundaries are moved forward to the next line start
+//
+static const char *
+window_end(const char *begin, const char *end)
+{
+  if ((size_t)(end - begin) <= TRACE_WINDOW) {
+    return end;
+  }
+  const char *nl = memchr(begin + TRACE_WINDOW, '\n',
+                          end - begin - TRACE_WINDOW);
+  return nl ? nl + 1 : end;
+}
+
+int
+trace_parse_file(const char *path, trace_batch_fn fn, void *arg)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+  struct stat st;
+  if (fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return 0;
+  }
+  if (st.st_size == 0) {
+    close(fd);
+    return 1;
+  }
+  char *text = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (text == MAP_FAILED) {
+    return 0;
+  }
+  madvise(text, st.st_size, MADV_SEQUENTIAL);
+
+  uint32_t nthreads = traceThreads;
+  if (nthreads == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    nthreads = (cpus > 0) ? (uint32_t)cpus : 1;
+  }
+  if (nthreads > TRACE_MAX_THREADS) {
+    nthreads = TRACE_MAX_THREADS;
+  }
+
+  trace_window *win = (trace_window *)calloc(2, sizeof(trace_window));
+  const char *end = text + st.st_size;
+  const char *next = window_end(text, end);
+  uint64_t lines = 0;
+  int cur = 0;
+
+  start_window(&win[cur], text, next, nthreads);
+  while (win[cur].nchunks) {
+    trace_window *w = &win[cur];
+    for (uint32_t k = 0; k < w->nchunks; k++) {
+      if (w->chunk[k].threaded) {
+        pthread_join(w->chunk[k].thread, NULL);
+      }
+    }
+
+    // Decode the next window while this one is being simulated
+    win[!cur].nchunks = 0;
+    if (next < end) {
+      const char *from = next;
+      next = window_end(from, end);
+      start_window(&win[!cur], from, next, nthreads);
+    }
+
+    for (uint32_t k = 0; k < w->nchunks; k++) {
+      trace_chunk *c = &w->chunk[k];
+      lines += c->lines;
+      if (c->error == TRACE_BAD_FLAG) {
+        fprintf(stderr,"Input Error '%c' must be one of 'I', 'D', 'R' or 'W' "
+            "(line %lu)\n", c->errorChar, lines);
+        exit(1);
+      } else if (c->error == TRACE_BAD_ADDR) {
+        fprintf(stderr,"Input Error malformed address (line %lu)\n", lines);
+        exit(1);
+      }
+      fn(c->addr, c->i_or_d, c->count, arg);
+    }
+    cur = !cur;
+  }
+
+  for (int i = 0; i < 2; i++) {
+    for (uint32_t k = 0; k < TRACE_MAX_THREADS; k++) {
+      free(win[i].chunk[k].addr);
+      free(win[i].chunk[k].i_or_d);
+    }
+  }
+  free(win);
+  munmap(text, st.st_size);
+  return 1;
+}
@@ -0,0 +1,41 @@
+//========================================================//
+//  trace.h                                               //
+//  Header file for the trace readers                     //
+//                                                        //
+//  Parses uncompressed text traces in parallel and       //
+//  hands the decoded references to the simulator         //
+//========================================================//
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+//------------------------------------//
+//        Trace Configuration         //
+//------------------------------------//
+
+extern uint32_t traceThreads;   // Number of parser threads (0 = one per CPU)
+
+//------------------------------------//
+//      Trace Function Prototypes     //
+//------------------------------------//
+
+// Called with each batch of decoded references, in trace order.
+// 'i_or_d[k]' tells where the access 'addr[k]' should be directed to:
+// 'I' for the icache, 'D' or 'R' for a dcache read, 'W' for a dcache write
+//
+typedef void (*trace_batch_fn)(const uint32_t *addr, const char *i_or_d,
+                               size_t n, void *arg);
+
+// Parse the uncompressed text trace at 'path' and pass every reference to
+// 'fn' in order. The file is mapped into memory and split at line
+// boundaries across 'traceThreads' parser threads. A malformed line is
+// reported with its line number and terminates the simulator.
+//
+// Returns True if Successful, False if 'path' can't be mapped (e.g. a pipe)
+//
+int trace_parse_file(const char *path, trace_batch_fn fn, void *arg);
+
+#endif